@@ -1,5 +1,5 @@
 #!/bin/bash
 FLAGS="-Wall -Wextra -Werror"
-RAYLIB="-I./raylib/include -L./raylib/lib -l:libraylib.a -lm"
-FILES="src/main.c src/utils.c src/simulation.c src/simulation_debug.c src/gui/*.c"
+RAYLIB="-I./raylib/include -L./raylib/lib -l:libraylib.a -lm -ldl -lpthread"
+FILES="src/main.c src/utils.c src/simulation.c src/simulation_debug.c src/simulation_netlist.c src/simulation_optimize.c src/simulation_native.c src/simulation_vm.c src/simulation_snapshot.c src/simulation_sweep.c src/simulation_stimulus.c src/simulation_fault.c src/simulation_truth.c src/simulation_equivalence.c src/simulation_thread.c src/gui/*.c"
 gcc $FLAGS -o main $FILES $RAYLIB
@@ -1,4 +1,7 @@
 #include "draw.h"
+#include "gui_atlas.h"
+#include "raymath.h"
+#include "rlgl.h"
 
 #define GUI_NAND_BG_COLOR CLITERAL(Color){ 191, 13, 78, 255 }
 #define GUI_NAND_FONT_SIZE 26
@@ -10,12 +13,97 @@
 
 #define GUI_WIRE_COLOR CLITERAL(Color){ 7, 86, 95, 255 }
 #define GUI_HIGH_WIRE_COLOR CLITERAL(Color){ 15, 182, 214, 255 }
+// used for X and Z
+#define GUI_UNKNOWN_WIRE_COLOR CLITERAL(Color){ 214, 69, 65, 255 }
 
 #define GUI_OUTPUT_COLOR CLITERAL(Color){ 58, 62, 74, 255 }
 #define GUI_OUTPUT_DEACTIVE_COLOR CLITERAL(Color){ 7, 86, 95, 255 }
 #define GUI_OUTPUT_ACTIVE_COLOR CLITERAL(Color){ 15, 182, 214, 255 }
+#define GUI_OUTPUT_UNKNOWN_COLOR CLITERAL(Color){ 214, 69, 65, 255 }
+
+#define GUI_CLOCK_COLOR CLITERAL(Color){ 58, 62, 74, 255 }
+#define GUI_CLOCK_ACTIVE_COLOR CLITERAL(Color){ 15, 182, 214, 255 }
+#define GUI_CLOCK_FONT_SIZE 20
+
+#define GUI_SEQUENTIAL_BG_COLOR CLITERAL(Color){ 101, 54, 163, 255 }
+#define GUI_GATE_BG_COLOR CLITERAL(Color){ 214, 113, 25, 255 }
+#define GUI_BOX_FONT_SIZE 20
+
+#define GUI_BUS_BG_COLOR CLITERAL(Color){ 58, 62, 74, 255 }
+
+// every wire is a quad made of two triangles
+#define GUI_WIRE_VERTICES 6
+#define GUI_WIRE_BATCH_INIT_CAPACITY 256
+
+// the wires are grouped in buckets by the square of the canvas where they start, so
+// only the buckets on screen are drawn and have their colors checked
+#define GUI_WIRE_BUCKET_SIZE (16*GUI_GRID_CELL_SIZE)
+
+typedef struct {
+    float *items;
+    size_t count;
+    size_t capacity;
+} FloatArray;
+
+typedef struct {
+    Color *items;
+    size_t count;
+    size_t capacity;
+} ColorArray;
+
+typedef struct {
+    // square of the canvas where its wires start, in GUI_WIRE_BUCKET_SIZE units
+    int x, y;
+    // box around all its wires, the bucket is drawn when it's on screen
+    Rectangle bounds;
+    // range of wireBatch.wires, and of the buffers, with its wires
+    size_t first;
+    size_t count;
+} WireBucket;
+
+typedef struct {
+    WireBucket *items;
+    size_t count;
+    size_t capacity;
+} WireBucketArray;
+
+typedef struct {
+    int x, y;
+    GUIWire *wire;
+} WireEntry;
+
+typedef struct {
+    WireEntry *items;
+    size_t count;
+    size_t capacity;
+} WireEntryArray;
+
+// the wires are drawn from buffers that stay in the GPU, the positions are only written
+// again when gui.layoutVersion changes and the colors of a bucket when one of its pins changes
+static struct {
+    FloatArray positions;
+    ColorArray colors;
+    // the wires in the order of the buffers, sorted by bucket
+    GUIWireArray wires;
+    WireBucketArray buckets;
+    // wires that fit in the GPU buffers
+    size_t capacity;
+    unsigned int vao;
+    unsigned int positionBuffer;
+    unsigned int colorBuffer;
+    // gui.layoutVersion when the geometry was built
+    size_t layoutVersion;
+    // the wires are never thinner than a pixel, so it depends on the zoom
+    float minThickness;
+    // the chip whose wires aren't in the buffers, its moves don't change them
+    GUIChip *skip;
+    size_t skipMoves;
+} wireBatch = {0};
 
 static void draw_nand(GUIChip *nand) {
+    Rectangle rec = { nand->pos.x, nand->pos.y, GUI_NAND_WIDTH, GUI_NAND_HEIGHT };
+    if(gui_atlas_draw_box("NAND", GUI_NAND_FONT_SIZE, rec, GUI_NAND_BG_COLOR)) return;
+
     DrawRectangle(nand->pos.x, nand->pos.y, GUI_NAND_WIDTH, GUI_NAND_HEIGHT, GUI_NAND_BG_COLOR);
 
     const char *text = "NAND";
@@ -43,11 +131,7 @@ static void draw_pin_array(GUIPinArray pinArr) {
 }
 
 static void draw_input(GUIChip *input) {
-    SimPin *pin = sim_chip_get_output_pin(input->simChip, 0);
-    if(pin == NULL) {
-        panic("Pin is NULL");
-    }
-    bool on = pin->state == PIN_HIGH;
+    bool on = gui_pin_get_state(&input->outputs.items[0]) == PIN_HIGH;
 
     Color color = on ? GUI_INPUT_ACTIVE_COLOR : GUI_INPUT_COLOR;
 
@@ -94,11 +178,8 @@ static void draw_input(GUIChip *input) {
 }
 
 static void draw_output(GUIChip *output) {
-    SimPin *pin = sim_chip_get_input_pin(output->simChip, 0);
-    if(pin == NULL) {
-        panic("Pin is NULL");
-    }
-    bool on = pin->state == PIN_HIGH;
+    SimPinState state = gui_pin_get_state(&output->inputs.items[0]);
+    bool on = state == PIN_HIGH;
 
     Rectangle rec = {
         .x = output->pos.x,
@@ -109,6 +190,7 @@ static void draw_output(GUIChip *output) {
     DrawRectangleLinesEx(rec, 5, GUI_OUTPUT_COLOR);
 
     Color color = on ? GUI_OUTPUT_ACTIVE_COLOR : GUI_OUTPUT_DEACTIVE_COLOR;
+    if(state == PIN_X) color = GUI_OUTPUT_UNKNOWN_COLOR;
     int innerWidth = 20;
     int innerHeight = 20;
     DrawRectangle(
@@ -118,7 +200,97 @@ static void draw_output(GUIChip *output) {
     );
 }
 
+static void draw_clock(GUIChip *clock) {
+    bool on = gui_pin_get_state(&clock->outputs.items[0]) == PIN_HIGH;
+
+    Rectangle rec = {
+        .x = clock->pos.x,
+        .y = clock->pos.y,
+        .width = GUI_CLOCK_WIDTH,
+        .height = GUI_CLOCK_HEIGHT,
+    };
+    Color color = on ? GUI_CLOCK_ACTIVE_COLOR : GUI_CLOCK_COLOR;
+    if(gui_atlas_draw_box("CLK", GUI_CLOCK_FONT_SIZE, rec, color)) return;
+    DrawRectangleRec(rec, color);
+
+    const char *text = "CLK";
+    int text_width = MeasureText(text, GUI_CLOCK_FONT_SIZE);
+    DrawText(
+        text,
+        clock->pos.x + GUI_CLOCK_WIDTH / 2 - text_width / 2,
+        clock->pos.y + GUI_CLOCK_HEIGHT / 2 - GUI_CLOCK_FONT_SIZE / 2,
+        GUI_CLOCK_FONT_SIZE,
+        WHITE
+    );
+}
+
+// gates, flip-flops, latches and registers are boxes with their name in the middle
+static void draw_box(GUIChip *chip, const char *text, Color color) {
+    // the whole box is draggable, so it has the size of the collider
+    Rectangle rec = {
+        .x = chip->pos.x,
+        .y = chip->pos.y,
+        .width = chip->colliders.draggable.width,
+        .height = chip->colliders.draggable.height,
+    };
+    if(gui_atlas_draw_box(text, GUI_BOX_FONT_SIZE, rec, color)) return;
+    DrawRectangleRec(rec, color);
+
+    int text_width = MeasureText(text, GUI_BOX_FONT_SIZE);
+    DrawText(
+        text,
+        rec.x + rec.width / 2 - text_width / 2,
+        rec.y + rec.height / 2 - GUI_BOX_FONT_SIZE / 2,
+        GUI_BOX_FONT_SIZE,
+        WHITE
+    );
+}
+
+static Color get_chip_color(GUIChip *chip) {
+    switch(chip->type) {
+        case GUI_CHIP_NAND:
+            return GUI_NAND_BG_COLOR;
+        case GUI_CHIP_INPUT:
+            return gui_pin_get_state(&chip->outputs.items[0]) == PIN_HIGH ? GUI_INPUT_ACTIVE_COLOR : GUI_INPUT_COLOR;
+        case GUI_CHIP_OUTPUT: {
+            SimPinState state = gui_pin_get_state(&chip->inputs.items[0]);
+            if(state == PIN_X) return GUI_OUTPUT_UNKNOWN_COLOR;
+            return state == PIN_HIGH ? GUI_OUTPUT_ACTIVE_COLOR : GUI_OUTPUT_DEACTIVE_COLOR;
+        }
+        case GUI_CHIP_CLOCK:
+            return gui_pin_get_state(&chip->outputs.items[0]) == PIN_HIGH ? GUI_CLOCK_ACTIVE_COLOR : GUI_CLOCK_COLOR;
+        case GUI_CHIP_DFF:
+        case GUI_CHIP_SR_LATCH:
+        case GUI_CHIP_REGISTER:
+            return GUI_SEQUENTIAL_BG_COLOR;
+        case GUI_CHIP_SPLITTER:
+        case GUI_CHIP_MERGER:
+            return GUI_BUS_BG_COLOR;
+        default:
+            return GUI_GATE_BG_COLOR;
+    }
+}
+
+// zoomed out the pins and labels can't be seen, the chip is a rectangle of at least a pixel
+static void draw_chip_lod(GUIChip *chip) {
+    float pixel = 1 / gui.camera.zoom;
+    Rectangle rec = {
+        .x = chip->pos.x + chip->colliders.draggable.offsetX,
+        .y = chip->pos.y + chip->colliders.draggable.offsetY,
+        .width = fmaxf(chip->colliders.draggable.width, pixel),
+        .height = fmaxf(chip->colliders.draggable.height, pixel),
+    };
+    // the input is a thin handle with the switch on its right
+    if(chip->type == GUI_CHIP_INPUT) rec.width = GUI_INPUT_DRAGGABLE_WIDTH + GUI_INPUT_DRAGGABLE_MARGIN + GUI_INPUT_WIDTH;
+    DrawRectangleRec(rec, get_chip_color(chip));
+}
+
 void gui_draw_chip(GUIChip *chip) {
+    if(gui.camera.zoom < GUI_LOD_ZOOM) {
+        draw_chip_lod(chip);
+        return;
+    }
+
     draw_pin_array(chip->inputs);
     draw_pin_array(chip->outputs);
 
@@ -132,39 +304,313 @@ void gui_draw_chip(GUIChip *chip) {
         case GUI_CHIP_OUTPUT:
             draw_output(chip);
             break;
+        case GUI_CHIP_CLOCK:
+            draw_clock(chip);
+            break;
+        case GUI_CHIP_DFF:
+            draw_box(chip, "DFF", GUI_SEQUENTIAL_BG_COLOR);
+            break;
+        case GUI_CHIP_SR_LATCH:
+            draw_box(chip, "SR", GUI_SEQUENTIAL_BG_COLOR);
+            break;
+        case GUI_CHIP_REGISTER:
+            draw_box(chip, "REG", GUI_SEQUENTIAL_BG_COLOR);
+            break;
+        case GUI_CHIP_AND:
+            draw_box(chip, "AND", GUI_GATE_BG_COLOR);
+            break;
+        case GUI_CHIP_OR:
+            draw_box(chip, "OR", GUI_GATE_BG_COLOR);
+            break;
+        case GUI_CHIP_XOR:
+            draw_box(chip, "XOR", GUI_GATE_BG_COLOR);
+            break;
+        case GUI_CHIP_NOR:
+            draw_box(chip, "NOR", GUI_GATE_BG_COLOR);
+            break;
+        case GUI_CHIP_XNOR:
+            draw_box(chip, "XNOR", GUI_GATE_BG_COLOR);
+            break;
+        case GUI_CHIP_NOT:
+            draw_box(chip, "NOT", GUI_GATE_BG_COLOR);
+            break;
+        case GUI_CHIP_BUF:
+            draw_box(chip, "BUF", GUI_GATE_BG_COLOR);
+            break;
+        // the bars are too thin for a name
+        case GUI_CHIP_SPLITTER:
+        case GUI_CHIP_MERGER:
+            draw_box(chip, "", GUI_BUS_BG_COLOR);
+            break;
     }
 }
 
+bool gui_draw_shows_state(GUIChip *chip) {
+    return chip->type == GUI_CHIP_INPUT || chip->type == GUI_CHIP_OUTPUT || chip->type == GUI_CHIP_CLOCK;
+}
+
 static bool is_pin_high(GUIPin *pin) {
-    return sim_pin_is_high(pin->simPin);
+    return gui_pin_get_state(pin) == PIN_HIGH;
+}
+
+static Color get_wire_color(GUIPin *src) {
+    if(gui_pin_get_state(src) == PIN_X) return GUI_UNKNOWN_WIRE_COLOR;
+    return is_pin_high(src) ? GUI_HIGH_WIRE_COLOR : GUI_WIRE_COLOR;
+}
+
+static float get_wire_thickness(GUIPin *pin) {
+    return pin->simPin->width > 1 ? GUI_BUS_WIRE_THICKNESS : GUI_WIRE_THICKNESS;
+}
+
+static void add_wire_vertex(Vector2 pos) {
+    da_append(&wireBatch.positions, pos.x);
+    da_append(&wireBatch.positions, pos.y);
+}
+
+// two triangles in the same order as DrawLineEx, so they aren't culled
+static void add_wire_quad(GUIWire *wire) {
+    Vector2 start = gui_pin_get_pos(wire->src);
+    Vector2 end = gui_pin_get_pos(wire->target);
+    Vector2 delta = Vector2Subtract(end, start);
+    float length = Vector2Length(delta);
+    Vector2 radius = {0};
+    if(length > 0) {
+        float thickness = fmaxf(get_wire_thickness(wire->src), wireBatch.minThickness);
+        float scale = thickness / (2*length);
+        radius = (Vector2){ -delta.y*scale, delta.x*scale };
+    }
+
+    Vector2 strip[4] = {
+        Vector2Subtract(start, radius),
+        Vector2Add(start, radius),
+        Vector2Subtract(end, radius),
+        Vector2Add(end, radius),
+    };
+    add_wire_vertex(strip[2]);
+    add_wire_vertex(strip[0]);
+    add_wire_vertex(strip[1]);
+    add_wire_vertex(strip[3]);
+    add_wire_vertex(strip[2]);
+    add_wire_vertex(strip[1]);
+}
+
+static void load_wire_buffers(void) {
+    wireBatch.vao = rlLoadVertexArray();
+    rlEnableVertexArray(wireBatch.vao);
+
+    wireBatch.positionBuffer = rlLoadVertexBuffer(NULL, wireBatch.capacity*GUI_WIRE_VERTICES*2*sizeof(float), true);
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 2, RL_FLOAT, false, 0, 0);
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+
+    wireBatch.colorBuffer = rlLoadVertexBuffer(NULL, wireBatch.capacity*GUI_WIRE_VERTICES*sizeof(Color), true);
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR, 4, RL_UNSIGNED_BYTE, true, 0, 0);
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR);
+
+    rlDisableVertexArray();
+}
+
+static void unload_wire_buffers(void) {
+    rlUnloadVertexArray(wireBatch.vao);
+    rlUnloadVertexBuffer(wireBatch.positionBuffer);
+    rlUnloadVertexBuffer(wireBatch.colorBuffer);
+}
+
+static bool is_wire_skipped(GUIWire *wire) {
+    return wire->src->parentChip == wireBatch.skip || wire->target->parentChip == wireBatch.skip;
+}
+
+static int compare_wire_entries(const void *a, const void *b) {
+    const WireEntry *first = a, *second = b;
+    if(first->y != second->y) return first->y < second->y ? -1 : 1;
+    if(first->x != second->x) return first->x < second->x ? -1 : 1;
+    return 0;
 }
 
-void gui_draw_wires(Set *wires) {
-    SetItem *wireItem = wires->head;
-    while(wireItem != NULL) {
-        GUIWire *wire = wireItem->data;
+static Rectangle get_wire_bounds(GUIWire *wire) {
+    Vector2 start = gui_pin_get_pos(wire->src);
+    Vector2 end = gui_pin_get_pos(wire->target);
+    float radius = fmaxf(get_wire_thickness(wire->src), wireBatch.minThickness) / 2;
+    Vector2 min = { fminf(start.x, end.x) - radius, fminf(start.y, end.y) - radius };
+    Vector2 max = { fmaxf(start.x, end.x) + radius, fmaxf(start.y, end.y) + radius };
+    return (Rectangle){ min.x, min.y, max.x - min.x, max.y - min.y };
+}
 
-        Vector2 startPos = gui_pin_get_pos(wire->src);
-        Vector2 endPos = gui_pin_get_pos(wire->target);
+static Rectangle merge_bounds(Rectangle a, Rectangle b) {
+    float minX = fminf(a.x, b.x), minY = fminf(a.y, b.y);
+    float maxX = fmaxf(a.x + a.width, b.x + b.width), maxY = fmaxf(a.y + a.height, b.y + b.height);
+    return (Rectangle){ minX, minY, maxX - minX, maxY - minY };
+}
 
-        Color wireColor = is_pin_high(wire->src) ? GUI_HIGH_WIRE_COLOR : GUI_WIRE_COLOR;
+static void build_wire_geometry(GUIWireArray *wires) {
+    static WireEntryArray entries = {0};
+    entries.count = 0;
+    for(size_t w = 0; w < wires->count; w++) {
+        GUIWire *wire = wires->items[w];
+        if(is_wire_skipped(wire)) continue;
+        Vector2 start = gui_pin_get_pos(wire->src);
+        WireEntry entry = {
+            .x = floorf(start.x / GUI_WIRE_BUCKET_SIZE),
+            .y = floorf(start.y / GUI_WIRE_BUCKET_SIZE),
+            .wire = wire,
+        };
+        da_append(&entries, entry);
+    }
+    if(entries.count > 0) qsort(entries.items, entries.count, sizeof(WireEntry), compare_wire_entries);
+
+    wireBatch.positions.count = 0;
+    wireBatch.colors.count = 0;
+    wireBatch.wires.count = 0;
+    wireBatch.buckets.count = 0;
+    for(size_t i = 0; i < entries.count; i++) {
+        WireEntry entry = entries.items[i];
+        WireBucket *bucket = wireBatch.buckets.count > 0 ? &wireBatch.buckets.items[wireBatch.buckets.count - 1] : NULL;
+        Rectangle bounds = get_wire_bounds(entry.wire);
+        if(bucket == NULL || bucket->x != entry.x || bucket->y != entry.y) {
+            WireBucket newBucket = { .x = entry.x, .y = entry.y, .bounds = bounds, .first = wireBatch.wires.count };
+            da_append(&wireBatch.buckets, newBucket);
+            bucket = &wireBatch.buckets.items[wireBatch.buckets.count - 1];
+        } else {
+            bucket->bounds = merge_bounds(bucket->bounds, bounds);
+        }
+        bucket->count++;
+
+        da_append(&wireBatch.wires, entry.wire);
+        add_wire_quad(entry.wire);
+        Color color = get_wire_color(entry.wire->src);
+        for(size_t j = 0; j < GUI_WIRE_VERTICES; j++) {
+            da_append(&wireBatch.colors, color);
+        }
+    }
 
-        DrawLineEx(startPos, endPos, GUI_WIRE_THICKNESS, wireColor);
+    // the buffers only grow, a smaller geometry is written at the start of them
+    size_t wireCount = wireBatch.wires.count;
+    if(wireCount > wireBatch.capacity) {
+        if(wireBatch.capacity > 0) unload_wire_buffers();
+        wireBatch.capacity = wireBatch.capacity > 0 ? wireBatch.capacity : GUI_WIRE_BATCH_INIT_CAPACITY;
+        while(wireBatch.capacity < wireCount) wireBatch.capacity *= 2;
+        load_wire_buffers();
+    }
+    if(wireCount == 0) return;
+    rlUpdateVertexBuffer(wireBatch.positionBuffer, wireBatch.positions.items, wireBatch.positions.count*sizeof(float), 0);
+    rlUpdateVertexBuffer(wireBatch.colorBuffer, wireBatch.colors.items, wireBatch.colors.count*sizeof(Color), 0);
+}
 
-        wireItem = wireItem->next;
+// the states of the pins change without touching the wires, so the colors of the buckets
+// on screen are checked every frame and only the wires between the first and the last
+// that changed are written again
+static void update_bucket_colors(WireBucket *bucket) {
+    size_t firstChanged = bucket->first + bucket->count;
+    size_t lastChanged = 0;
+    for(size_t w = bucket->first; w < bucket->first + bucket->count; w++) {
+        Color color = get_wire_color(wireBatch.wires.items[w]->src);
+        Color *colors = &wireBatch.colors.items[w*GUI_WIRE_VERTICES];
+        if(ColorIsEqual(*colors, color)) continue;
+        for(size_t i = 0; i < GUI_WIRE_VERTICES; i++) colors[i] = color;
+        if(firstChanged > w) firstChanged = w;
+        lastChanged = w;
     }
+    if(firstChanged > lastChanged) return;
+
+    size_t offset = firstChanged*GUI_WIRE_VERTICES;
+    size_t count = (lastChanged - firstChanged + 1)*GUI_WIRE_VERTICES;
+    rlUpdateVertexBuffer(wireBatch.colorBuffer, &wireBatch.colors.items[offset], count*sizeof(Color), offset*sizeof(Color));
+}
+
+static float get_min_wire_thickness(void) {
+    return gui.camera.zoom < GUI_LOD_ZOOM ? 1 / gui.camera.zoom : 0;
+}
+
+static void enable_wire_buffers(void) {
+    int *locs = rlGetShaderLocsDefault();
+    rlEnableShader(rlGetShaderIdDefault());
+    Matrix modelview = MatrixMultiply(rlGetMatrixTransform(), rlGetMatrixModelview());
+    rlSetUniformMatrix(locs[RL_SHADER_LOC_MATRIX_MVP], MatrixMultiply(modelview, rlGetMatrixProjection()));
+    float white[4] = { 1, 1, 1, 1 };
+    rlSetUniform(locs[RL_SHADER_LOC_COLOR_DIFFUSE], white, RL_SHADER_UNIFORM_VEC4, 1);
+    rlActiveTextureSlot(0);
+    rlEnableTexture(rlGetTextureIdDefault());
+
+    // without vertex arrays (OpenGL ES 2.0) the buffers are bound on every draw
+    if(!rlEnableVertexArray(wireBatch.vao)) {
+        rlEnableVertexBuffer(wireBatch.positionBuffer);
+        rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 2, RL_FLOAT, false, 0, 0);
+        rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+        rlEnableVertexBuffer(wireBatch.colorBuffer);
+        rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR, 4, RL_UNSIGNED_BYTE, true, 0, 0);
+        rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR);
+    }
+}
+
+static void disable_wire_buffers(void) {
+    rlDisableVertexArray();
+    rlDisableVertexBuffer();
+    rlDisableTexture();
+    rlDisableShader();
+}
+
+void gui_draw_wires(GUIWireArray *wires, GUIChip *skip) {
+    float minThickness = get_min_wire_thickness();
+    if(wireBatch.layoutVersion + wireBatch.skipMoves != gui.layoutVersion || wireBatch.minThickness != minThickness
+        || wireBatch.skip != skip) {
+        wireBatch.layoutVersion = gui.layoutVersion;
+        wireBatch.skipMoves = 0;
+        wireBatch.minThickness = minThickness;
+        wireBatch.skip = skip;
+        build_wire_geometry(wires);
+    }
+    if(wireBatch.wires.count == 0) return;
+
+    // what raylib has batched so far has to be drawn below the wires
+    rlDrawRenderBatchActive();
+
+    // the buckets next to each other in the buffers are drawn with a single call
+    Rectangle area = gui_visible_area();
+    size_t first = 0, count = 0;
+    bool enabled = false;
+    for(size_t b = 0; b <= wireBatch.buckets.count; b++) {
+        WireBucket *bucket = b < wireBatch.buckets.count ? &wireBatch.buckets.items[b] : NULL;
+        bool visible = bucket != NULL && CheckCollisionRecs(bucket->bounds, area);
+        if(visible) {
+            update_bucket_colors(bucket);
+            if(count > 0 && first + count == bucket->first) {
+                count += bucket->count;
+                continue;
+            }
+        }
+        if(count > 0) {
+            if(!enabled) enable_wire_buffers();
+            enabled = true;
+            rlDrawVertexArray(first*GUI_WIRE_VERTICES, count*GUI_WIRE_VERTICES);
+            count = 0;
+        }
+        if(visible) {
+            first = bucket->first;
+            count = bucket->count;
+        }
+    }
+    if(enabled) disable_wire_buffers();
+}
+
+void gui_draw_wires_chip_moved(GUIChip *chip) {
+    if(chip == wireBatch.skip) wireBatch.skipMoves++;
+}
+
+void gui_draw_wire(GUIWire *wire) {
+    float thickness = fmaxf(get_wire_thickness(wire->src), get_min_wire_thickness());
+    DrawLineEx(gui_pin_get_pos(wire->src), gui_pin_get_pos(wire->target), thickness, get_wire_color(wire->src));
 }
 
 void gui_draw_unfinished_wire(GUIWire *wire) {
-    Vector2 mousePos = GetMousePosition();
+    Vector2 mousePos = gui_mouse_pos();
 
     Vector2 startPos = wire->src != NULL ? gui_pin_get_pos(wire->src) : mousePos;
     Vector2 endPos = wire->target != NULL ? gui_pin_get_pos(wire->target) : mousePos;
 
     Color wireColor = GUI_WIRE_COLOR;
-    if(wire->src != NULL && is_pin_high(wire->src)) {
-        wireColor = GUI_HIGH_WIRE_COLOR;
+    if(wire->src != NULL) {
+        wireColor = get_wire_color(wire->src);
     }
 
-    DrawLineEx(startPos, endPos, GUI_WIRE_THICKNESS, wireColor);
+    GUIPin *pin = wire->src != NULL ? wire->src : wire->target;
+    DrawLineEx(startPos, endPos, get_wire_thickness(pin), wireColor);
 }
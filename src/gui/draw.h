@@ -4,7 +4,20 @@
 #include "gui.h"
 
 void gui_draw_chip(GUIChip *chip);
-void gui_draw_wires(Set *wires);
+/*
+ * @return true when the chip looks different depending on the state of its pins.
+ */
+bool gui_draw_shows_state(GUIChip *chip);
+/*
+ * Draws the wires on screen but the ones connected to "skip", which can be NULL.
+ */
+void gui_draw_wires(GUIWireArray *wires, GUIChip *skip);
+/*
+ * Should be called when "chip" moves, the wires aren't built again when it's the skipped chip.
+ */
+void gui_draw_wires_chip_moved(GUIChip *chip);
+// draws a single wire without the vertex buffer of gui_draw_wires
+void gui_draw_wire(GUIWire *wire);
 void gui_draw_unfinished_wire(GUIWire *wire);
 
 #endif // DRAW_H
@@ -1,12 +1,78 @@
 #include "gui.h"
+#include "gui_atlas.h"
+
+#include <math.h>
+
+#include "raymath.h"
 
 GUI gui = {0};
 
-void gui_init() {
+void gui_init(SimContext *sim) {
+    gui.sim = sim;
+    gui.simThread = sim_thread_start(sim);
+    gui.pinStates = sim_thread_read(gui.simThread);
     gui.chips = set_new();
-    gui.wires = set_new();
+    gui.layoutVersion = 1;
+    gui.gateInputs = SIM_GATE_DEFAULT_INPUTS;
+    gui.busWidth = SIM_BUS_DEFAULT_WIDTH;
+    gui.camera.zoom = 1;
+    gui.run.rate = GUI_RUN_DEFAULT_RATE;
+    gui_atlas_init();
+}
+
+static void update_camera(void) {
+    if(IsMouseButtonDown(MOUSE_BUTTON_MIDDLE)) {
+        Vector2 delta = GetMouseDelta();
+        gui.camera.target = Vector2Subtract(gui.camera.target, Vector2Scale(delta, 1 / gui.camera.zoom));
+    }
+
+    float wheel = GetMouseWheelMove();
+    if(wheel != 0) {
+        // zooms around the mouse, the point under it stays in the same place
+        Vector2 mouse = GetMousePosition();
+        gui.camera.target = GetScreenToWorld2D(mouse, gui.camera);
+        gui.camera.offset = mouse;
+        gui.camera.zoom = Clamp(gui.camera.zoom*powf(GUI_ZOOM_STEP, wheel), GUI_MIN_ZOOM, GUI_MAX_ZOOM);
+    }
 }
 
 void gui_update() {
+    gui.pinStates = sim_thread_read(gui.simThread);
+    update_camera();
+
     gui_sim_update();
+    gui_sim_draw();
+
+    gui_sim_update_run();
+}
+
+Vector2 gui_mouse_pos(void) {
+    return GetScreenToWorld2D(GetMousePosition(), gui.camera);
+}
+
+Rectangle gui_visible_area(void) {
+    Vector2 topLeft = GetScreenToWorld2D((Vector2){ 0, 0 }, gui.camera);
+    Vector2 bottomRight = GetScreenToWorld2D((Vector2){ GetScreenWidth(), GetScreenHeight() }, gui.camera);
+    return (Rectangle){
+        topLeft.x,
+        topLeft.y,
+        bottomRight.x - topLeft.x,
+        bottomRight.y - topLeft.y,
+    };
+}
+
+bool gui_has_input(void) {
+    if(IsWindowResized() || gui.run.running || sim_thread_busy(gui.simThread)) return true;
+
+    for(int key = 1; key < GUI_MAX_KEYS; key++) {
+        if(IsKeyPressed(key) || IsKeyPressedRepeat(key) || IsKeyReleased(key)) return true;
+    }
+    for(int button = MOUSE_BUTTON_LEFT; button <= MOUSE_BUTTON_MIDDLE; button++) {
+        if(IsMouseButtonPressed(button) || IsMouseButtonReleased(button)) return true;
+    }
+    if(GetMouseWheelMove() != 0) return true;
+
+    Vector2 delta = GetMouseDelta();
+    bool following = gui.state != GUI_STATE_NONE || IsMouseButtonDown(MOUSE_BUTTON_MIDDLE);
+    return following && (delta.x != 0 || delta.y != 0);
 }
@@ -2,8 +2,28 @@
 #define GUI_H
 
 #include "gui_simulation.h"
+#include "gui_grid.h"
+#include "../simulation_thread.h"
 #include "../utils.h"
 
+// frames drawn after an input before sleeping again, the chips react after the
+// wires are drawn so a change is only complete on screen in the next frame
+#define GUI_BUSY_FRAMES 2
+
+// raylib keeps the state of this many keys (MAX_KEYBOARD_KEYS)
+#define GUI_MAX_KEYS 512
+
+#define GUI_BG_COLOR CLITERAL(Color){ 16, 14, 23, 255 }
+
+// the mouse wheel zooms by this factor on every step
+#define GUI_ZOOM_STEP 1.1f
+#define GUI_MIN_ZOOM 0.01f
+#define GUI_MAX_ZOOM 4.0f
+// below this zoom the chips are flat rectangles without pins or labels
+#define GUI_LOD_ZOOM 0.3f
+// below this zoom only a map of where the chips and wires are is drawn (see gui_overview.h)
+#define GUI_OVERVIEW_ZOOM 0.03f
+
 typedef enum {
     GUI_STATE_NONE,
     GUI_STATE_DRAGGING_CHIP,
@@ -11,25 +31,95 @@ typedef enum {
     GUI_STATE_DELETING_CHIP,
 } GUIState;
 
+// the clocks ticking on their own, see gui_sim_toggle_run
+typedef struct {
+    bool running;
+    // index in the list of rates
+    size_t rate;
+    // measure of the ticks per second
+    size_t measureTicks;
+    double measureStart;
+    double ticksPerSecond;
+} GUIRun;
+
+// the chips that didn't change since the last frame, drawn once to a texture that is
+// transparent around them, so the wires are drawn below it every frame
+typedef struct {
+    RenderTexture2D texture;
+    // what was drawn in the texture, it's drawn again when anything is different
+    Camera2D camera;
+    size_t layoutVersion;
+    // the chip being dragged isn't in the layer, so its moves don't count as changes
+    GUIChip *excluded;
+    size_t excludedMoves;
+    // the chips in the texture that show the state of their pins (see gui_draw_shows_state)
+    // and the states of their pins, one after the other, when they were drawn
+    GUIChipArray stateChips;
+    SimPinStateArray states;
+} GUILayer;
+
 typedef struct {
+    // the simulation shown by the gui, it belongs to "simThread" so it's only used
+    // through its commands (see simulation_thread.h)
+    SimContext *sim;
+    SimThread *simThread;
+    // the last states published by "simThread", read at the start of every frame
+    SimPinStateArray *pinStates;
+    // the chips live in an infinite canvas seen through the camera, it's moved
+    // dragging with the middle button and zoomed with the wheel
+    Camera2D camera;
     Set *chips;
+    // order given to the next chip that is added, see GUIChip.order
+    size_t nextChipOrder;
+    GUIGrid grid;
 
     GUIState state;
     GUIChip *draggingChip;
     GUIChip *chipToDelete;
 
-    Set *wires;
+    // the wires are in no particular order, see GUIWire.index
+    GUIWireArray wires;
+    // incremented when a chip or a wire is added, removed or moved, what is built
+    // from the positions (like the geometry of the wires) is only built again then
+    size_t layoutVersion;
     // used when we're wiring
     GUIWire *currentWire;
+
+    // number of inputs of the next wide gate that is added
+    size_t gateInputs;
+    // bits of the next splitter or merger that is added
+    size_t busWidth;
+
+    GUIRun run;
+    GUILayer layer;
 } GUI;
 
 extern GUI gui;
 
 /*
- * Initializes the "gui" variable. Should be called before any "gui" function.
+ * Initializes the "gui" variable to show "sim". Should be called before any "gui" function,
+ * after the window is created.
  */
-void gui_init();
+void gui_init(SimContext *sim);
 
 void gui_update();
 
+/*
+ * @return the position of the mouse in the canvas
+ */
+Vector2 gui_mouse_pos(void);
+
+/*
+ * @return the part of the canvas that is on screen
+ */
+Rectangle gui_visible_area(void);
+
+/*
+ * @return true when there was input since the last frame that can change what is on
+ * screen. Moving the mouse only counts while a chip, a wire or the camera follows it.
+ * The simulation thread counts as input while it's running or has new states to show,
+ * and so does the run mode.
+ */
+bool gui_has_input(void);
+
 #endif // GUI_H
@@ -0,0 +1,93 @@
+#include "gui_atlas.h"
+#include "../utils.h"
+
+typedef struct {
+    const char *text;
+    int fontSize;
+    int width;
+    int height;
+    Color color;
+    // false when the atlas was full, the sprite is kept so the warning is only shown once
+    bool fits;
+    Rectangle source;
+} Sprite;
+
+typedef struct {
+    Sprite *items;
+    size_t count;
+    size_t capacity;
+} SpriteArray;
+
+static struct {
+    Texture2D texture;
+    SpriteArray sprites;
+    // the sprites are added in rows from left to right
+    int cursorX;
+    int cursorY;
+    int rowHeight;
+} atlas = {0};
+
+void gui_atlas_init(void) {
+    Image image = GenImageColor(GUI_ATLAS_SIZE, GUI_ATLAS_SIZE, BLANK);
+    // the white corner used to draw the shapes
+    ImageDrawRectangle(&image, 0, 0, 2, 2, WHITE);
+    atlas.texture = LoadTextureFromImage(image);
+    UnloadImage(image);
+
+    SetShapesTexture(atlas.texture, (Rectangle){ 0, 0, 1, 1 });
+    atlas.cursorX = 2 + GUI_ATLAS_PADDING;
+}
+
+static Sprite *find_sprite(const char *text, int fontSize, int width, int height, Color color) {
+    for(size_t i = 0; i < atlas.sprites.count; i++) {
+        Sprite *sprite = &atlas.sprites.items[i];
+        if(sprite->text == text && sprite->fontSize == fontSize && sprite->width == width
+            && sprite->height == height && ColorIsEqual(sprite->color, color)) {
+            return sprite;
+        }
+    }
+    return NULL;
+}
+
+static Sprite *add_sprite(const char *text, int fontSize, int width, int height, Color color) {
+    if(atlas.cursorX + width > GUI_ATLAS_SIZE) {
+        atlas.cursorX = 0;
+        atlas.cursorY += atlas.rowHeight + GUI_ATLAS_PADDING;
+        atlas.rowHeight = 0;
+    }
+    Sprite sprite = {
+        .text = text,
+        .fontSize = fontSize,
+        .width = width,
+        .height = height,
+        .color = color,
+        .fits = atlas.cursorX + width <= GUI_ATLAS_SIZE && atlas.cursorY + height <= GUI_ATLAS_SIZE,
+        .source = { atlas.cursorX, atlas.cursorY, width, height },
+    };
+    da_append(&atlas.sprites, sprite);
+    if(!sprite.fits) {
+        TraceLog(LOG_WARNING, "The atlas is full, a %dx%d \"%s\" will be drawn without it", width, height, text);
+        return &atlas.sprites.items[atlas.sprites.count - 1];
+    }
+
+    Image image = GenImageColor(width, height, color);
+    int textWidth = MeasureText(text, fontSize);
+    ImageDrawText(&image, text, width / 2 - textWidth / 2, height / 2 - fontSize / 2, fontSize, WHITE);
+    UpdateTextureRec(atlas.texture, sprite.source, image.data);
+    UnloadImage(image);
+
+    atlas.cursorX += width + GUI_ATLAS_PADDING;
+    if(height > atlas.rowHeight) atlas.rowHeight = height;
+    return &atlas.sprites.items[atlas.sprites.count - 1];
+}
+
+bool gui_atlas_draw_box(const char *text, int fontSize, Rectangle rec, Color color) {
+    int width = rec.width;
+    int height = rec.height;
+    Sprite *sprite = find_sprite(text, fontSize, width, height, color);
+    if(sprite == NULL) sprite = add_sprite(text, fontSize, width, height, color);
+    if(!sprite->fits) return false;
+
+    DrawTextureRec(atlas.texture, sprite->source, (Vector2){ rec.x, rec.y }, WHITE);
+    return true;
+}
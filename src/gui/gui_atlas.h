@@ -0,0 +1,34 @@
+#ifndef GUI_ATLAS_H
+#define GUI_ATLAS_H
+
+#include "raylib.h"
+
+/*
+ * Texture where the bodies of the chips are rendered once, with their label,
+ * so drawing a chip is a single textured quad instead of a rectangle and a
+ * text. The shapes of raylib are also drawn from a white corner of the atlas,
+ * this way the chips never change the texture and raylib can draw them all
+ * in the same batch.
+ *
+ * A sprite is made the first time a body is drawn and it's kept until the
+ * end, the bodies are identified by their label, size and color.
+ */
+
+#define GUI_ATLAS_SIZE 2048
+// empty pixels between the sprites
+#define GUI_ATLAS_PADDING 1
+
+/*
+ * Should be called after the window is created.
+ */
+void gui_atlas_init(void);
+
+/*
+ * Draws a rectangle of "color" with "text" in the middle.
+ * "text" should be a string literal, the sprites are found comparing the pointer.
+ *
+ * @return false when the sprite doesn't fit in the atlas, nothing is drawn then
+ */
+bool gui_atlas_draw_box(const char *text, int fontSize, Rectangle rec, Color color);
+
+#endif // GUI_ATLAS_H
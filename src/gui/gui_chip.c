@@ -39,6 +39,79 @@ static void chip_add_output_pin(GUIChip *chip, Vector2 initialPos) {
     da_append(&chip->outputs, pin);
 }
 
+// places the pins of the chip evenly along its left (inputs) and right (outputs) sides
+static void chip_add_spaced_pins(GUIChip *chip, float width, float height) {
+    size_t inputCount = chip->simChip->inputs.count;
+    for(size_t i = 0; i < inputCount; i++) {
+        chip_add_input_pin(chip, (Vector2){0, height * (i + 0.5f) / inputCount});
+    }
+
+    size_t outputCount = chip->simChip->outputs.count;
+    for(size_t i = 0; i < outputCount; i++) {
+        chip_add_output_pin(chip, (Vector2){width, height * (i + 0.5f) / outputCount});
+    }
+}
+
+static void chip_set_box_colliders(GUIChip *chip, float width, float height) {
+    chip->colliders.draggable.width = width;
+    chip->colliders.draggable.height = height;
+
+    chip->colliders.deletable.width = width;
+    chip->colliders.deletable.height = height;
+}
+
+static SimChipType get_gate_sim_type(GUIChipType type) {
+    switch(type) {
+        case GUI_CHIP_AND: return SIM_CHIP_AND;
+        case GUI_CHIP_OR: return SIM_CHIP_OR;
+        case GUI_CHIP_XOR: return SIM_CHIP_XOR;
+        case GUI_CHIP_NOR: return SIM_CHIP_NOR;
+        case GUI_CHIP_XNOR: return SIM_CHIP_XNOR;
+        case GUI_CHIP_NOT: return SIM_CHIP_NOT;
+        case GUI_CHIP_BUF: return SIM_CHIP_BUF;
+        default: panic("Not a gate");
+    }
+    return SIM_CHIP_NAND;
+}
+
+// the simulated chip of the gates is already created
+static void chip_init_gate(GUIChip *chip) {
+    float height = chip->simChip->inputs.count * GUI_GATE_PIN_SPACING;
+    if(height < GUI_GATE_MIN_HEIGHT) height = GUI_GATE_MIN_HEIGHT;
+
+    chip_set_box_colliders(chip, GUI_GATE_WIDTH, height);
+    chip_add_spaced_pins(chip, GUI_GATE_WIDTH, height);
+}
+
+GUIChip *gui_chip_new_gate(GUIChipType type, size_t inputCount, Vector2 initialPos) {
+    GUIChip *chip = alloc(sizeof(GUIChip));
+    chip->type = type;
+    chip->pos = initialPos;
+    chip->simChip = sim_chip_new_gate(get_gate_sim_type(type), inputCount);
+    chip_init_gate(chip);
+
+    return chip;
+}
+
+// the simulated chip of the splitters and mergers is already created
+static void chip_init_bus(GUIChip *chip) {
+    size_t width = chip->type == GUI_CHIP_SPLITTER ? chip->simChip->outputs.count : chip->simChip->inputs.count;
+    float height = width * GUI_BUS_PIN_SPACING;
+
+    chip_set_box_colliders(chip, GUI_BUS_WIDTH, height);
+    chip_add_spaced_pins(chip, GUI_BUS_WIDTH, height);
+}
+
+GUIChip *gui_chip_new_bus(GUIChipType type, size_t width, Vector2 initialPos) {
+    GUIChip *chip = alloc(sizeof(GUIChip));
+    chip->type = type;
+    chip->pos = initialPos;
+    chip->simChip = sim_chip_new_bus(type == GUI_CHIP_SPLITTER ? SIM_CHIP_SPLITTER : SIM_CHIP_MERGER, width);
+    chip_init_bus(chip);
+
+    return chip;
+}
+
 GUIChip *gui_chip_new(GUIChipType type, Vector2 initialPos) {
     GUIChip *chip = alloc(sizeof(GUIChip));
     chip->type = type;
@@ -85,17 +158,60 @@ GUIChip *gui_chip_new(GUIChipType type, Vector2 initialPos) {
             chip_add_input_pin(chip, (Vector2){0, GUI_OUTPUT_HEIGHT / 2});
 
             break;
-    }
+        case GUI_CHIP_CLOCK:
+            chip->simChip = sim_chip_new(SIM_CHIP_CLOCK);
+
+            chip->colliders.draggable.width = GUI_CLOCK_WIDTH;
+            chip->colliders.draggable.height = GUI_CLOCK_HEIGHT;
 
-    sim_add_chip(chip->simChip);
+            chip->colliders.deletable.width = GUI_CLOCK_WIDTH;
+            chip->colliders.deletable.height = GUI_CLOCK_HEIGHT;
+
+            chip_add_output_pin(chip, (Vector2){GUI_CLOCK_WIDTH, GUI_CLOCK_HEIGHT / 2});
+
+            break;
+        case GUI_CHIP_DFF:
+        case GUI_CHIP_SR_LATCH:
+            chip->simChip = sim_chip_new(type == GUI_CHIP_DFF ? SIM_CHIP_DFF : SIM_CHIP_SR_LATCH);
+            chip_set_box_colliders(chip, GUI_LATCH_WIDTH, GUI_LATCH_HEIGHT);
+            chip_add_spaced_pins(chip, GUI_LATCH_WIDTH, GUI_LATCH_HEIGHT);
+            break;
+        case GUI_CHIP_REGISTER: {
+            chip->simChip = sim_chip_new(SIM_CHIP_REGISTER);
+            float height = chip->simChip->inputs.count * GUI_REGISTER_PIN_SPACING;
+            chip_set_box_colliders(chip, GUI_REGISTER_WIDTH, height);
+            chip_add_spaced_pins(chip, GUI_REGISTER_WIDTH, height);
+        } break;
+        case GUI_CHIP_AND:
+        case GUI_CHIP_OR:
+        case GUI_CHIP_XOR:
+        case GUI_CHIP_NOR:
+        case GUI_CHIP_XNOR:
+        case GUI_CHIP_NOT:
+        case GUI_CHIP_BUF:
+            chip->simChip = sim_chip_new(get_gate_sim_type(type));
+            chip_init_gate(chip);
+            break;
+        case GUI_CHIP_SPLITTER:
+        case GUI_CHIP_MERGER:
+            chip->simChip = sim_chip_new(type == GUI_CHIP_SPLITTER ? SIM_CHIP_SPLITTER : SIM_CHIP_MERGER);
+            chip_init_bus(chip);
+            break;
+    }
 
     return chip;
 }
 
+// the simulated chip is freed by the simulation thread, see gui_sim_remove_chip
 void gui_chip_free(GUIChip *chip) {
+    for(size_t i = 0; i < chip->inputs.count; i++) {
+        da_free(&chip->inputs.items[i].wires);
+    }
+    for(size_t i = 0; i < chip->outputs.count; i++) {
+        da_free(&chip->outputs.items[i].wires);
+    }
     da_free(&chip->inputs);
     da_free(&chip->outputs);
-    sim_chip_free(chip->simChip);
     free(chip);
 }
 
@@ -121,12 +237,17 @@ static void handle_wiring(GUIPin *pin) {
             gui.currentWire->src = pin;
         }
 
-        sim_pin_add_connection(
-            gui.currentWire->src->simPin,
-            gui.currentWire->target->simPin
-        );
+        // the pins have different widths
+        SimPin *src = gui.currentWire->src->simPin;
+        SimPin *target = gui.currentWire->target->simPin;
+        if(src->width != target->width) {
+            gui_wire_free(gui.currentWire);
+            gui.currentWire = NULL;
+            return;
+        }
+        sim_thread_post(gui.simThread, (SimCommand){ .type = SIM_COMMAND_CONNECT, .src = src, .target = target });
 
-        set_add(gui.wires, gui.currentWire);
+        gui_wire_add(gui.currentWire);
         gui.currentWire = NULL;
     } else {
         // start wiring
@@ -143,7 +264,7 @@ static void handle_wiring(GUIPin *pin) {
 }
 
 static void update_pin_array(GUIPinArray arr) {
-    Vector2 mousePos = GetMousePosition();
+    Vector2 mousePos = gui_mouse_pos();
 
     for(size_t i = 0; i < arr.count; i++) {
         GUIPin *pin = &arr.items[i];
@@ -168,6 +289,17 @@ static Rectangle get_rec_from_collider_and_vec(GUIChipCollider collider, Vector2
     };
 }
 
+GUIChip *gui_chip_at(Vector2 pos) {
+    GUIChipArray *cell = gui_grid_at(pos);
+    for(size_t i = cell->count; i > 0; i--) {
+        GUIChip *chip = cell->items[i - 1];
+        if(CheckCollisionPointRec(pos, get_rec_from_collider_and_vec(chip->colliders.draggable, chip->pos))) {
+            return chip;
+        }
+    }
+    return NULL;
+}
+
 // deletes all the wires that contains any pin in the array in either the src or target fields
 static void delete_wires_from_pin_array(GUIPinArray pinArr) {
     for(size_t i = 0; i < pinArr.count; i++) {
@@ -180,7 +312,6 @@ static void delete_wires_from_pin_array(GUIPinArray pinArr) {
 static void delete_chip(GUIChip *chip) {
     delete_wires_from_pin_array(chip->inputs);
     delete_wires_from_pin_array(chip->outputs);
-    sim_remove_chip(chip->simChip);
     gui_sim_remove_chip(chip);
     gui_chip_free(chip);
 }
@@ -198,17 +329,15 @@ void gui_chip_update(GUIChip *chip) {
                 .width = GUI_INPUT_WIDTH,
                 .height = GUI_INPUT_HEIGHT,
             };
-            bool collision = CheckCollisionPointRec(GetMousePosition(), collider);
+            bool collision = CheckCollisionPointRec(gui_mouse_pos(), collider);
             if(collision && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-                if(!sim_chip_toggle_output_pin(chip->simChip, 0)) {
-                    panic("Output Pin not found");
-                }
+                sim_thread_post(gui.simThread, (SimCommand){ .type = SIM_COMMAND_TOGGLE, .chip = chip->simChip, .index = 0 });
             }
         } break;
         default: break;
     }
 
-    Vector2 mousePos = GetMousePosition();
+    Vector2 mousePos = gui_mouse_pos();
 
     // Dragging
     Rectangle draggableCollider = get_rec_from_collider_and_vec(chip->colliders.draggable, chip->pos);
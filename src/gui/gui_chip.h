@@ -5,8 +5,29 @@
 
 GUIChip *gui_chip_new(GUIChipType type, Vector2 initialPos);
 
+/*
+ * Creates a wide gate (AND, OR, XOR, NOR or XNOR) with "inputCount" inputs,
+ * gui_chip_new creates them with SIM_GATE_DEFAULT_INPUTS.
+ */
+GUIChip *gui_chip_new_gate(GUIChipType type, size_t inputCount, Vector2 initialPos);
+
+/*
+ * Creates a splitter or a merger of a bus of "width" bits,
+ * gui_chip_new creates them with SIM_BUS_DEFAULT_WIDTH.
+ */
+GUIChip *gui_chip_new_bus(GUIChipType type, size_t width, Vector2 initialPos);
+
+/*
+ * Frees the chip but not its simulated chip, that one is freed by gui_sim_remove_chip.
+ */
 void gui_chip_free(GUIChip *chip);
 
 void gui_chip_update(GUIChip *chip);
 
+/*
+ * @return the chip that can be dragged from "pos", the one drawn on top
+ * when there are several, or NULL when there's none
+ */
+GUIChip *gui_chip_at(Vector2 pos);
+
 #endif // GUI_CHIP_H
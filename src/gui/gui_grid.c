@@ -0,0 +1,155 @@
+#include "gui.h"
+#include "gui_grid.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t cell_hash(int x, int y) {
+    size_t hash = (size_t)(unsigned)x*73856093u ^ (size_t)(unsigned)y*19349663u;
+    return hash & (GUI_GRID_BUCKETS - 1);
+}
+
+static int to_cell(float coordinate) {
+    return floorf(coordinate / GUI_GRID_CELL_SIZE);
+}
+
+static void add_to_bounds(Rectangle *bounds, Rectangle rec) {
+    float right = fmaxf(bounds->x + bounds->width, rec.x + rec.width);
+    float bottom = fmaxf(bounds->y + bounds->height, rec.y + rec.height);
+    bounds->x = fminf(bounds->x, rec.x);
+    bounds->y = fminf(bounds->y, rec.y);
+    bounds->width = right - bounds->x;
+    bounds->height = bottom - bounds->y;
+}
+
+static void add_pins_to_bounds(Rectangle *bounds, GUIPinArray pins) {
+    for(size_t i = 0; i < pins.count; i++) {
+        Vector2 pos = gui_pin_get_pos(&pins.items[i]);
+        add_to_bounds(bounds, (Rectangle){
+            pos.x - GUI_PIN_RADIUS,
+            pos.y - GUI_PIN_RADIUS,
+            GUI_PIN_RADIUS*2,
+            GUI_PIN_RADIUS*2,
+        });
+    }
+}
+
+// everything of the chip that can be clicked
+static Rectangle get_chip_bounds(GUIChip *chip) {
+    GUIChipCollider draggable = chip->colliders.draggable;
+    GUIChipCollider deletable = chip->colliders.deletable;
+    Rectangle bounds = {
+        chip->pos.x + draggable.offsetX,
+        chip->pos.y + draggable.offsetY,
+        draggable.width,
+        draggable.height,
+    };
+    add_to_bounds(&bounds, (Rectangle){
+        chip->pos.x + deletable.offsetX,
+        chip->pos.y + deletable.offsetY,
+        deletable.width,
+        deletable.height,
+    });
+    add_pins_to_bounds(&bounds, chip->inputs);
+    add_pins_to_bounds(&bounds, chip->outputs);
+    return bounds;
+}
+
+// the bucket is kept sorted by the order of the chips
+static void bucket_insert(GUIChipArray *bucket, GUIChip *chip) {
+    size_t i = bucket->count;
+    while(i > 0 && bucket->items[i - 1]->order >= chip->order) {
+        // several cells of the chip can share the bucket
+        if(bucket->items[i - 1] == chip) return;
+        i--;
+    }
+
+    da_append(bucket, chip);
+    memmove(&bucket->items[i + 1], &bucket->items[i], (bucket->count - 1 - i)*sizeof(GUIChip *));
+    bucket->items[i] = chip;
+}
+
+static void bucket_remove(GUIChipArray *bucket, GUIChip *chip) {
+    for(size_t i = 0; i < bucket->count; i++) {
+        if(bucket->items[i] != chip) continue;
+        memmove(&bucket->items[i], &bucket->items[i + 1], (bucket->count - 1 - i)*sizeof(GUIChip *));
+        bucket->count--;
+        return;
+    }
+}
+
+void gui_grid_insert(GUIChip *chip) {
+    Rectangle bounds = get_chip_bounds(chip);
+    chip->cells.minX = to_cell(bounds.x);
+    chip->cells.minY = to_cell(bounds.y);
+    chip->cells.maxX = to_cell(bounds.x + bounds.width);
+    chip->cells.maxY = to_cell(bounds.y + bounds.height);
+
+    for(int y = chip->cells.minY; y <= chip->cells.maxY; y++) {
+        for(int x = chip->cells.minX; x <= chip->cells.maxX; x++) {
+            bucket_insert(&gui.grid.buckets[cell_hash(x, y)], chip);
+        }
+    }
+}
+
+void gui_grid_remove(GUIChip *chip) {
+    for(int y = chip->cells.minY; y <= chip->cells.maxY; y++) {
+        for(int x = chip->cells.minX; x <= chip->cells.maxX; x++) {
+            bucket_remove(&gui.grid.buckets[cell_hash(x, y)], chip);
+        }
+    }
+}
+
+void gui_grid_move(GUIChip *chip) {
+    gui_grid_remove(chip);
+    gui_grid_insert(chip);
+}
+
+GUIChipArray *gui_grid_at(Vector2 pos) {
+    return &gui.grid.buckets[cell_hash(to_cell(pos.x), to_cell(pos.y))];
+}
+
+static bool touches_cells(GUIChip *chip, int minX, int minY, int maxX, int maxY) {
+    return chip->cells.minX <= maxX && chip->cells.maxX >= minX
+        && chip->cells.minY <= maxY && chip->cells.maxY >= minY;
+}
+
+static int compare_order(const void *a, const void *b) {
+    size_t orderA = (*(GUIChip **)a)->order;
+    size_t orderB = (*(GUIChip **)b)->order;
+    return (orderA > orderB) - (orderA < orderB);
+}
+
+void gui_grid_query(Rectangle area, GUIChipArray *chips) {
+    int minX = to_cell(area.x);
+    int minY = to_cell(area.y);
+    int maxX = to_cell(area.x + area.width);
+    int maxY = to_cell(area.y + area.height);
+
+    // gui.chips is already in order
+    double cellCount = ((double)maxX - minX + 1)*((double)maxY - minY + 1);
+    if(cellCount > GUI_GRID_BUCKETS) {
+        for(SetItem *item = gui.chips->head; item != NULL; item = item->next) {
+            GUIChip *chip = item->data;
+            if(touches_cells(chip, minX, minY, maxX, maxY)) da_append(chips, chip);
+        }
+        return;
+    }
+
+    size_t first = chips->count;
+    size_t query = ++gui.grid.query;
+    for(int y = minY; y <= maxY; y++) {
+        for(int x = minX; x <= maxX; x++) {
+            GUIChipArray *bucket = &gui.grid.buckets[cell_hash(x, y)];
+            for(size_t i = 0; i < bucket->count; i++) {
+                GUIChip *chip = bucket->items[i];
+                // the bucket can have chips of far away cells
+                if(chip->query == query || !touches_cells(chip, minX, minY, maxX, maxY)) continue;
+                chip->query = query;
+                da_append(chips, chip);
+            }
+        }
+    }
+    if(chips->count > first) qsort(&chips->items[first], chips->count - first, sizeof(GUIChip *), compare_order);
+}
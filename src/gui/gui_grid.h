@@ -0,0 +1,52 @@
+#ifndef GUI_GRID_H
+#define GUI_GRID_H
+
+#include "gui_simulation.h"
+
+/*
+ * Spatial index of the chips used to know what is under the mouse without
+ * checking every chip. The screen is split in square cells and every chip is
+ * added to the cells its box and its pins touch. The cells are hashed into
+ * a fixed number of buckets, so far away cells can share a bucket and the
+ * chips of a bucket still have to be checked one by one.
+ */
+
+#define GUI_GRID_CELL_SIZE 128
+// must be a power of two
+#define GUI_GRID_BUCKETS 16384
+
+typedef struct {
+    GUIChip **items;
+    size_t count;
+    size_t capacity;
+} GUIChipArray;
+
+typedef struct {
+    GUIChipArray buckets[GUI_GRID_BUCKETS];
+    // incremented by every gui_grid_query, see GUIChip.query
+    size_t query;
+} GUIGrid;
+
+void gui_grid_insert(GUIChip *chip);
+
+void gui_grid_remove(GUIChip *chip);
+
+/*
+ * Should be called after the chip changes its position.
+ */
+void gui_grid_move(GUIChip *chip);
+
+/*
+ * @return the chips that could be at "pos", in the order they're drawn (see
+ * GUIChip.order). The array changes when a chip is added, moved or removed.
+ */
+GUIChipArray *gui_grid_at(Vector2 pos);
+
+/*
+ * Appends to "chips" the chips whose cells touch "area", in the order they're drawn.
+ * Costs about as much as the chips found, unless "area" has more cells than there
+ * are buckets, then every chip is checked.
+ */
+void gui_grid_query(Rectangle area, GUIChipArray *chips);
+
+#endif // GUI_GRID_H
@@ -0,0 +1,123 @@
+#include "gui.h"
+#include "gui_overview.h"
+
+#include <math.h>
+
+#include "raymath.h"
+
+#define GUI_OVERVIEW_COLOR CLITERAL(Color){ 15, 182, 214, 255 }
+
+static struct {
+    Texture2D texture;
+    // canvas covered by the texture
+    Rectangle area;
+    // gui.layoutVersion when the map was built
+    size_t layoutVersion;
+} overview = {0};
+
+typedef struct {
+    float *density;
+    int width;
+    int height;
+    // top left cell of the map
+    int minX;
+    int minY;
+    int cellsPerPixel;
+} DensityMap;
+
+static void add_density(DensityMap *map, Vector2 pos, float amount) {
+    int x = floorf(pos.x / GUI_GRID_CELL_SIZE) - map->minX;
+    int y = floorf(pos.y / GUI_GRID_CELL_SIZE) - map->minY;
+    if(x < 0 || y < 0) return;
+    x /= map->cellsPerPixel;
+    y /= map->cellsPerPixel;
+    if(x >= map->width || y >= map->height) return;
+    map->density[y*map->width + x] += amount;
+}
+
+// the wire is sampled twice per pixel, so it adds to every pixel it crosses
+static void add_wire(DensityMap *map, GUIWire *wire) {
+    Vector2 start = gui_pin_get_pos(wire->src);
+    Vector2 end = gui_pin_get_pos(wire->target);
+    float pixelSize = map->cellsPerPixel*GUI_GRID_CELL_SIZE;
+    size_t samples = Vector2Distance(start, end) / (pixelSize / 2) + 1;
+    for(size_t i = 0; i <= samples; i++) {
+        add_density(map, Vector2Lerp(start, end, (float)i / samples), GUI_OVERVIEW_WIRE_WEIGHT / 2);
+    }
+}
+
+static void build_overview(void) {
+    if(gui.chips->count == 0) {
+        overview.area = (Rectangle){0};
+        return;
+    }
+
+    DensityMap map = {0};
+    int maxX = 0, maxY = 0;
+    bool first = true;
+    for(SetItem *item = gui.chips->head; item != NULL; item = item->next) {
+        GUIChip *chip = item->data;
+        if(first || chip->cells.minX < map.minX) map.minX = chip->cells.minX;
+        if(first || chip->cells.minY < map.minY) map.minY = chip->cells.minY;
+        if(first || chip->cells.maxX > maxX) maxX = chip->cells.maxX;
+        if(first || chip->cells.maxY > maxY) maxY = chip->cells.maxY;
+        first = false;
+    }
+    int cellsX = maxX - map.minX + 1;
+    int cellsY = maxY - map.minY + 1;
+    int cells = cellsX > cellsY ? cellsX : cellsY;
+    map.cellsPerPixel = (cells + GUI_OVERVIEW_MAX_SIZE - 1) / GUI_OVERVIEW_MAX_SIZE;
+    map.width = (cellsX + map.cellsPerPixel - 1) / map.cellsPerPixel;
+    map.height = (cellsY + map.cellsPerPixel - 1) / map.cellsPerPixel;
+    map.density = alloc(map.width*map.height*sizeof(float));
+
+    for(SetItem *item = gui.chips->head; item != NULL; item = item->next) {
+        GUIChip *chip = item->data;
+        add_density(&map, chip->pos, 1);
+    }
+    for(size_t i = 0; i < gui.wires.count; i++) {
+        add_wire(&map, gui.wires.items[i]);
+    }
+
+    // logarithmic, so the sparse parts of the circuit can still be seen next to the dense ones
+    float max = 0;
+    for(int i = 0; i < map.width*map.height; i++) {
+        if(map.density[i] > max) max = map.density[i];
+    }
+    Image image = GenImageColor(map.width, map.height, BLANK);
+    Color *pixels = image.data;
+    for(int i = 0; i < map.width*map.height; i++) {
+        if(map.density[i] == 0) continue;
+        pixels[i] = GUI_OVERVIEW_COLOR;
+        pixels[i].a = 64 + 191*log1pf(map.density[i]) / log1pf(max);
+    }
+
+    if(overview.texture.width != map.width || overview.texture.height != map.height) {
+        if(overview.texture.id != 0) UnloadTexture(overview.texture);
+        overview.texture = LoadTextureFromImage(image);
+        SetTextureFilter(overview.texture, TEXTURE_FILTER_BILINEAR);
+    } else {
+        UpdateTexture(overview.texture, image.data);
+    }
+    UnloadImage(image);
+    free(map.density);
+
+    float pixelSize = map.cellsPerPixel*GUI_GRID_CELL_SIZE;
+    overview.area = (Rectangle){
+        map.minX*GUI_GRID_CELL_SIZE,
+        map.minY*GUI_GRID_CELL_SIZE,
+        map.width*pixelSize,
+        map.height*pixelSize,
+    };
+}
+
+void gui_overview_draw(void) {
+    if(overview.layoutVersion != gui.layoutVersion) {
+        overview.layoutVersion = gui.layoutVersion;
+        build_overview();
+    }
+    if(overview.area.width == 0) return;
+
+    Rectangle source = { 0, 0, overview.texture.width, overview.texture.height };
+    DrawTexturePro(overview.texture, source, overview.area, (Vector2){0}, 0, WHITE);
+}
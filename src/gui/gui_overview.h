@@ -0,0 +1,21 @@
+#ifndef GUI_OVERVIEW_H
+#define GUI_OVERVIEW_H
+
+#include "raylib.h"
+
+/*
+ * Map of the whole canvas used when it's so zoomed out that the chips would be
+ * smaller than a pixel. Every pixel of the map covers some cells of the grid
+ * (see gui_grid.h) and is brighter the more chips and wires there are in them.
+ * It's a single texture, so drawing it costs the same for any circuit, and it's
+ * only built again when gui.layoutVersion changes.
+ */
+
+// max width and height of the map in pixels
+#define GUI_OVERVIEW_MAX_SIZE 1024
+// a chip counts as 1, the wires count this much each time they cross a pixel
+#define GUI_OVERVIEW_WIRE_WEIGHT 0.25f
+
+void gui_overview_draw(void);
+
+#endif // GUI_OVERVIEW_H
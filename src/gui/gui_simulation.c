@@ -2,27 +2,40 @@
 #include "gui_simulation.h"
 #include "gui_chip.h"
 #include "draw.h"
+#include "gui_overview.h"
+#include "../simulation_sweep.h"
+#include "../simulation_fault.h"
+#include "../simulation_truth.h"
+#include "../simulation_equivalence.h"
+
+#include <string.h>
 
 #include "raymath.h"
+#include "rlgl.h"
 
 static void update_chips(void) {
-    SetItem *chipItem = gui.chips->head;
-    while(chipItem != NULL) {
-        GUIChip *chip = chipItem->data;
-        // here we change the item right away since the chip can be removed
-        // by the "update_chip" function
-        chipItem = chipItem->next;
-        gui_chip_update(chip);
+    // everything a chip does starts with a click, so only the chips under the mouse are updated
+    if(!IsMouseButtonPressed(MOUSE_BUTTON_LEFT) && !IsMouseButtonPressed(MOUSE_BUTTON_RIGHT)) return;
+
+    // the chips are copied since "gui_chip_update" can remove them from the grid
+    GUIChipArray *cell = gui_grid_at(gui_mouse_pos());
+    size_t count = cell->count;
+    GUIChip *chips[count + 1];
+    memcpy(chips, cell->items, count*sizeof(GUIChip *));
+    for(size_t i = 0; i < count; i++) {
+        gui_chip_update(chips[i]);
     }
 }
 
-static void draw_chips(void) {
-    SetItem *chipItem = gui.chips->head;
-    while(chipItem != NULL) {
-        GUIChip *chip = chipItem->data;
-        gui_draw_chip(chip);
-        chipItem = chipItem->next;
+// only the chips in "area" are drawn, the array with them changes in the next call
+static GUIChipArray *draw_chips(Rectangle area, GUIChip *skip) {
+    static GUIChipArray visible = {0};
+    visible.count = 0;
+    gui_grid_query(area, &visible);
+    for(size_t i = 0; i < visible.count; i++) {
+        if(visible.items[i] != skip) gui_draw_chip(visible.items[i]);
     }
+    return &visible;
 }
 
 static void handle_dragging_chip(void) {
@@ -31,8 +44,15 @@ static void handle_dragging_chip(void) {
         return;
     }
 
-    Vector2 delta = GetMouseDelta();
-    gui.draggingChip->pos = Vector2Add(gui.draggingChip->pos, delta);
+    // the chip moves in the canvas, so the delta is scaled by the zoom
+    Vector2 delta = Vector2Scale(GetMouseDelta(), 1 / gui.camera.zoom);
+    if(delta.x != 0 || delta.y != 0) {
+        gui.draggingChip->pos = Vector2Add(gui.draggingChip->pos, delta);
+        gui_grid_move(gui.draggingChip);
+        gui.layoutVersion++;
+        if(gui.layer.excluded == gui.draggingChip) gui.layer.excludedMoves++;
+        gui_draw_wires_chip_moved(gui.draggingChip);
+    }
 
     // cancel dragging
     if(IsMouseButtonReleased(MOUSE_BUTTON_LEFT)) {
@@ -42,8 +62,6 @@ static void handle_dragging_chip(void) {
 }
 
 static void handle_wiring(void) {
-    gui_draw_unfinished_wire(gui.currentWire);
-
     // cancel wiring
     if(IsMouseButtonPressed(MOUSE_BUTTON_RIGHT)) {
         gui.state = GUI_STATE_NONE;
@@ -52,7 +70,6 @@ static void handle_wiring(void) {
 }
 
 void gui_sim_update(void) {
-    gui_draw_wires(gui.wires);
     update_chips();
 
     switch(gui.state) {
@@ -64,23 +81,377 @@ void gui_sim_update(void) {
             break;
         default: break;
     }
+}
+
+static bool is_overview(void) {
+    return gui.camera.zoom < GUI_OVERVIEW_ZOOM;
+}
+
+static bool layer_is_valid(void) {
+    GUILayer *layer = &gui.layer;
+    if(layer->texture.texture.width != GetScreenWidth() || layer->texture.texture.height != GetScreenHeight()) return false;
+
+    Camera2D camera = layer->camera;
+    if(!Vector2Equals(camera.target, gui.camera.target) || !Vector2Equals(camera.offset, gui.camera.offset)
+        || camera.zoom != gui.camera.zoom) return false;
+
+    if(layer->excluded != gui.draggingChip) return false;
+    return layer->layoutVersion + layer->excludedMoves == gui.layoutVersion;
+}
+
+// the layer is transparent around the chips, so its colors are stored multiplied by their
+// alpha and it's drawn with BLEND_ALPHA_PREMULTIPLY, otherwise the edges would be blended twice
+static void begin_layer_blend(void) {
+    rlSetBlendFactorsSeparate(RL_SRC_ALPHA, RL_ONE_MINUS_SRC_ALPHA, RL_ONE, RL_ONE_MINUS_SRC_ALPHA, RL_FUNC_ADD, RL_FUNC_ADD);
+    BeginBlendMode(BLEND_CUSTOM_SEPARATE);
+}
+
+// @return true when a pin of "chip" changed since the states at "drawn", which are updated
+static bool update_drawn_states(GUIChip *chip, SimPinState **drawn) {
+    bool changed = false;
+    GUIPinArray pinArrays[2] = { chip->inputs, chip->outputs };
+    for(size_t i = 0; i < 2; i++) {
+        for(size_t j = 0; j < pinArrays[i].count; j++) {
+            SimPinState state = gui_pin_get_state(&pinArrays[i].items[j]);
+            if(**drawn != state) changed = true;
+            **drawn = state;
+            (*drawn)++;
+        }
+    }
+    return changed;
+}
+
+static void draw_layer(void) {
+    GUILayer *layer = &gui.layer;
+    if(layer->texture.texture.width != GetScreenWidth() || layer->texture.texture.height != GetScreenHeight()) {
+        if(layer->texture.id != 0) UnloadRenderTexture(layer->texture);
+        layer->texture = LoadRenderTexture(GetScreenWidth(), GetScreenHeight());
+    }
+    layer->camera = gui.camera;
+    layer->excluded = gui.draggingChip;
+    layer->excludedMoves = 0;
+    layer->layoutVersion = gui.layoutVersion;
+    layer->stateChips.count = 0;
+    layer->states.count = 0;
+
+    BeginTextureMode(layer->texture);
+    ClearBackground(BLANK);
+    begin_layer_blend();
+    BeginMode2D(gui.camera);
+    // too far away to see the chips, a map of where they are is drawn instead
+    if(is_overview()) {
+        gui_overview_draw();
+    } else {
+        GUIChipArray *drawn = draw_chips(gui_visible_area(), layer->excluded);
+        for(size_t i = 0; i < drawn->count; i++) {
+            GUIChip *chip = drawn->items[i];
+            if(chip == layer->excluded || !gui_draw_shows_state(chip)) continue;
+            da_append(&layer->stateChips, chip);
+            for(size_t j = 0; j < chip->inputs.count; j++) {
+                da_append(&layer->states, gui_pin_get_state(&chip->inputs.items[j]));
+            }
+            for(size_t j = 0; j < chip->outputs.count; j++) {
+                da_append(&layer->states, gui_pin_get_state(&chip->outputs.items[j]));
+            }
+        }
+    }
+    EndMode2D();
+    EndBlendMode();
+    EndTextureMode();
+}
+
+// only the cells of the chip are cleared and drawn again, with every chip in them since
+// they can overlap it, the rest of the layer stays as it is
+static void redraw_cells(GUIChip *chip) {
+    float size = GUI_GRID_CELL_SIZE;
+    Rectangle area = {
+        .x = chip->cells.minX*size,
+        .y = chip->cells.minY*size,
+        .width = (chip->cells.maxX - chip->cells.minX + 1)*size,
+        .height = (chip->cells.maxY - chip->cells.minY + 1)*size,
+    };
+    Vector2 min = GetWorldToScreen2D((Vector2){ area.x, area.y }, gui.camera);
+    Vector2 max = GetWorldToScreen2D((Vector2){ area.x + area.width, area.y + area.height }, gui.camera);
+    int x = floorf(min.x), y = floorf(min.y);
+    BeginScissorMode(x, y, (int)ceilf(max.x) - x, (int)ceilf(max.y) - y);
+    ClearBackground(BLANK);
+    BeginMode2D(gui.camera);
+    draw_chips(area, gui.layer.excluded);
+    EndMode2D();
+    EndScissorMode();
+}
 
-    // remember to draw the chips below the wires!
-    draw_chips();
+// the chips that show the state of their pins are drawn again when it changes, instead of
+// the whole layer
+static void redraw_changed_chips(void) {
+    GUILayer *layer = &gui.layer;
+    SimPinState *states = layer->states.items;
+    bool drawing = false;
+    for(size_t i = 0; i < layer->stateChips.count; i++) {
+        GUIChip *chip = layer->stateChips.items[i];
+        if(!update_drawn_states(chip, &states)) continue;
+        if(!drawing) {
+            BeginTextureMode(layer->texture);
+            begin_layer_blend();
+            drawing = true;
+        }
+        redraw_cells(chip);
+    }
+    if(drawing) {
+        EndBlendMode();
+        EndTextureMode();
+    }
+}
+
+static void draw_dragging_chip(void) {
+    GUIChip *chip = gui.draggingChip;
+    if(chip == NULL || is_overview()) return;
+
+    GUIPinArray pinArrays[2] = { chip->inputs, chip->outputs };
+    for(size_t i = 0; i < 2; i++) {
+        for(size_t j = 0; j < pinArrays[i].count; j++) {
+            GUIWireArray *wires = &pinArrays[i].items[j].wires;
+            for(size_t k = 0; k < wires->count; k++) {
+                gui_draw_wire(wires->items[k]);
+            }
+        }
+    }
+    gui_draw_chip(chip);
+}
+
+void gui_sim_draw(void) {
+    // the wires aren't in the layer, the colors of the ones on screen are updated in place
+    // (see gui_draw_wires) and the chips are drawn above them
+    if(!is_overview()) {
+        BeginMode2D(gui.camera);
+        gui_draw_wires(&gui.wires, gui.draggingChip);
+        EndMode2D();
+    }
+
+    if(layer_is_valid()) {
+        redraw_changed_chips();
+    } else {
+        draw_layer();
+    }
+
+    // the render textures are upside down
+    Texture2D texture = gui.layer.texture.texture;
+    BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+    DrawTextureRec(texture, (Rectangle){ 0, 0, texture.width, -texture.height }, (Vector2){0}, WHITE);
+    EndBlendMode();
+
+    BeginMode2D(gui.camera);
+    draw_dragging_chip();
+    if(gui.state == GUI_STATE_WIRING) gui_draw_unfinished_wire(gui.currentWire);
+    EndMode2D();
 }
 
 void gui_sim_add_chip(GUIChip *chip) {
-    set_add(gui.chips, chip);
+    chip->order = gui.nextChipOrder++;
+    chip->item = set_add(gui.chips, chip);
+    gui_grid_insert(chip);
+    gui.layoutVersion++;
+
+    sim_thread_post(gui.simThread, (SimCommand){ .type = SIM_COMMAND_ADD_CHIP, .chip = chip->simChip });
+    for(size_t i = 0; i < chip->inputs.count; i++) {
+        chip->inputs.items[i].slot = sim_thread_watch(gui.simThread, chip->inputs.items[i].simPin);
+    }
+    for(size_t i = 0; i < chip->outputs.count; i++) {
+        chip->outputs.items[i].slot = sim_thread_watch(gui.simThread, chip->outputs.items[i].simPin);
+    }
 }
 
 void gui_sim_remove_chip(GUIChip *chip) {
-    set_delete(gui.chips, chip);
+    gui_grid_remove(chip);
+    set_delete_item(gui.chips, chip->item);
+    gui.layoutVersion++;
+
+    for(size_t i = 0; i < chip->inputs.count; i++) {
+        sim_thread_unwatch(gui.simThread, chip->inputs.items[i].slot);
+    }
+    for(size_t i = 0; i < chip->outputs.count; i++) {
+        sim_thread_unwatch(gui.simThread, chip->outputs.items[i].slot);
+    }
+    sim_thread_post(gui.simThread, (SimCommand){ .type = SIM_COMMAND_REMOVE_CHIP, .chip = chip->simChip });
+}
+
+// ticks per second of the run mode, 0 is as fast as possible
+static const size_t runRates[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 100000, 1000000, 0 };
+#define RUN_RATE_COUNT (sizeof(runRates) / sizeof(runRates[0]))
+
+static void log_run_rate(void) {
+    size_t rate = runRates[gui.run.rate];
+    if(rate == 0) {
+        TraceLog(LOG_INFO, "Run at max speed");
+    } else {
+        TraceLog(LOG_INFO, "Run at %zu ticks/s", rate);
+    }
+}
+
+static void post_run(void) {
+    if(gui.run.running) {
+        sim_thread_post(gui.simThread, (SimCommand){ .type = SIM_COMMAND_RUN, .index = runRates[gui.run.rate] });
+    } else {
+        sim_thread_post(gui.simThread, (SimCommand){ .type = SIM_COMMAND_STOP });
+    }
+}
+
+void gui_sim_toggle_run(void) {
+    gui.run.running = !gui.run.running;
+    gui.run.measureTicks = atomic_load(&gui.simThread->ticks);
+    gui.run.measureStart = GetTime();
+    gui.run.ticksPerSecond = 0;
+    post_run();
+    if(gui.run.running) log_run_rate();
+}
+
+void gui_sim_change_rate(int steps) {
+    long rate = (long)gui.run.rate + steps;
+    if(rate < 0) rate = 0;
+    if(rate >= (long)RUN_RATE_COUNT) rate = RUN_RATE_COUNT - 1;
+    gui.run.rate = rate;
+    if(gui.run.running) post_run();
+    log_run_rate();
+}
+
+static void draw_run_status(void) {
+    size_t rate = runRates[gui.run.rate];
+    const char *text;
+    if(rate == 0) {
+        text = TextFormat("RUN max: %.0f ticks/s", gui.run.ticksPerSecond);
+    } else {
+        text = TextFormat("RUN %zu: %.0f ticks/s", rate, gui.run.ticksPerSecond);
+    }
+    DrawText(text, GUI_RUN_FONT_SIZE / 2, GUI_RUN_FONT_SIZE / 2, GUI_RUN_FONT_SIZE, WHITE);
+}
+
+void gui_sim_update_run(void) {
+    if(!gui.run.running) return;
+
+    double now = GetTime();
+    if(now - gui.run.measureStart >= GUI_RUN_MEASURE_TIME) {
+        size_t ticks = atomic_load(&gui.simThread->ticks);
+        gui.run.ticksPerSecond = (ticks - gui.run.measureTicks) / (now - gui.run.measureStart);
+        gui.run.measureTicks = ticks;
+        gui.run.measureStart = now;
+    }
+    draw_run_status();
+}
+
+void gui_sim_tick(void) {
+    sim_thread_post(gui.simThread, (SimCommand){ .type = SIM_COMMAND_TICK });
+}
+
+void gui_sim_scrub(long steps) {
+    sim_thread_post(gui.simThread, (SimCommand){ .type = SIM_COMMAND_SCRUB, .steps = steps });
+}
+
+void gui_sim_reset(void) {
+    sim_thread_post(gui.simThread, (SimCommand){ .type = SIM_COMMAND_RESET });
+}
+
+void gui_sim_fast_forward(size_t cycles, bool untilChange) {
+    sim_thread_post(gui.simThread, (SimCommand){
+        .type = untilChange ? SIM_COMMAND_FAST_FORWARD_UNTIL_CHANGE : SIM_COMMAND_FAST_FORWARD,
+        .index = cycles,
+    });
+}
+
+void gui_sim_run_job(SimJob job, Set *chips, void *data) {
+    sim_thread_post(gui.simThread, (SimCommand){ .type = SIM_COMMAND_JOB, .job = job, .chips = chips, .data = data });
+}
+
+static void sweep_job(SimContext *context, Set *chips, void *data) {
+    (void)chips;
+    (void)data;
+    double start = GetTime();
+    bool ok = sim_sweep_run(context, GUI_SWEEP_STIMULUS_PATH, GUI_SWEEP_RESULTS_PATH, (SimSweepOptions){
+        .cyclesPerVector = 1,
+    });
+    if(ok) {
+        TraceLog(LOG_INFO, "Wrote %s in %.3fs", GUI_SWEEP_RESULTS_PATH, GetTime() - start);
+    }
+}
+
+void gui_sim_sweep(void) {
+    gui_sim_run_job(sweep_job, NULL, NULL);
+}
+
+static void fault_grade_job(SimContext *context, Set *chips, void *data) {
+    (void)chips;
+    (void)data;
+    double start = GetTime();
+    bool ok = sim_fault_run(context, GUI_SWEEP_STIMULUS_PATH, GUI_FAULT_REPORT_PATH, (SimFaultOptions){
+        .cyclesPerVector = 1,
+    });
+    if(ok) {
+        TraceLog(LOG_INFO, "Wrote %s in %.3fs", GUI_FAULT_REPORT_PATH, GetTime() - start);
+    }
+}
+
+void gui_sim_fault_grade(void) {
+    gui_sim_run_job(fault_grade_job, NULL, NULL);
+}
+
+static void truth_table_job(SimContext *context, Set *chips, void *data) {
+    (void)data;
+    double start = GetTime();
+    bool ok = sim_truth_table_run(context, chips, GUI_TRUTH_TABLE_PATH, (SimTruthTableOptions){0});
+    if(ok) {
+        TraceLog(LOG_INFO, "Wrote %s in %.3fs", GUI_TRUTH_TABLE_PATH, GetTime() - start);
+    }
+}
+
+void gui_sim_truth_table(void) {
+    GUIChip *chip = gui_chip_at(gui_mouse_pos());
+    Set *selection = NULL;
+    if(chip != NULL) {
+        selection = set_new();
+        set_add(selection, chip->simChip);
+    }
+    gui_sim_run_job(truth_table_job, selection, NULL);
+}
+
+static void check_netlist_job(SimContext *context, Set *chips, void *data) {
+    (void)chips;
+    (void)data;
+    double start = GetTime();
+    SimContext *contexts[2] = { context, context };
+    SimEquivalenceResult result;
+    bool ok = sim_equivalence_check(contexts, (SimEquivalenceOptions){
+        .vectors = GUI_EQUIVALENCE_VECTORS,
+        .cyclesPerVector = 1,
+        .netlists = {
+            { .backend = SIM_BACKEND_LEVELIZED },
+            { .optimize = true, .collapseLuts = true, .backend = SIM_BACKEND_VM },
+        },
+    }, &result);
+    if(!ok) return;
+
+    if(result.equivalent) {
+        TraceLog(LOG_INFO, "The optimized VM netlist matches the unoptimized levelized one after %d vectors (%.3fs)",
+            GUI_EQUIVALENCE_VECTORS, GetTime() - start);
+    } else {
+        TraceLog(LOG_WARNING, "Vector %zu (%s) gives %d in output %zu of the unoptimized levelized netlist but %d in the optimized VM one",
+            result.vector, result.inputs, result.values[0], result.output, result.values[1]);
+    }
+    sim_equivalence_result_free(&result);
+}
+
+void gui_sim_check_netlist(void) {
+    gui_sim_run_job(check_netlist_job, NULL, NULL);
 }
 
 Vector2 gui_pin_get_pos(GUIPin *pin) {
     return Vector2Add(pin->parentChip->pos, pin->pos);
 }
 
+SimPinState gui_pin_get_state(GUIPin *pin) {
+    // the pin was added after the last snapshot
+    if(pin->slot >= gui.pinStates->count) return PIN_LOW;
+    return gui.pinStates->items[pin->slot];
+}
+
 GUIWire *gui_wire_new() {
     return alloc(sizeof(GUIWire));
 }
@@ -89,20 +460,44 @@ void gui_wire_free(GUIWire *wire) {
     free(wire);
 }
 
-void gui_wire_delete_by_pin(GUIPin *pin) {
-    SetItem *wireItem = gui.wires->head;
-    while(wireItem != NULL) {
-        GUIWire *wire = wireItem->data;
-        // wireItem will be freed when ui_wire_delete is called
-        wireItem = wireItem->next;
-        if(wire->src == pin || wire->target == pin) {
-            // delete wire
-            sim_pin_remove_connection(
-                wire->src->simPin,
-                wire->target->simPin
-            );
-            gui_wire_free(wire);
-            set_delete(gui.wires, wire);
+void gui_wire_add(GUIWire *wire) {
+    wire->index = gui.wires.count;
+    da_append(&gui.wires, wire);
+    da_append(&wire->src->wires, wire);
+    da_append(&wire->target->wires, wire);
+    gui.layoutVersion++;
+}
+
+// the order of the wires doesn't matter, so the last one takes the place of the removed one
+static void remove_pin_wire(GUIPin *pin, GUIWire *wire) {
+    for(size_t i = 0; i < pin->wires.count; i++) {
+        if(pin->wires.items[i] == wire) {
+            pin->wires.items[i] = pin->wires.items[--pin->wires.count];
+            return;
         }
     }
+    assert(false && "The wire isn't in the wires of its pin");
+}
+
+static void delete_wire(GUIWire *wire) {
+    sim_thread_post(gui.simThread, (SimCommand){
+        .type = SIM_COMMAND_DISCONNECT,
+        .src = wire->src->simPin,
+        .target = wire->target->simPin,
+    });
+    remove_pin_wire(wire->src, wire);
+    remove_pin_wire(wire->target, wire);
+
+    GUIWire *last = gui.wires.items[--gui.wires.count];
+    gui.wires.items[wire->index] = last;
+    last->index = wire->index;
+
+    gui_wire_free(wire);
+    gui.layoutVersion++;
+}
+
+void gui_wire_delete_by_pin(GUIPin *pin) {
+    while(pin->wires.count > 0) {
+        delete_wire(pin->wires.items[pin->wires.count - 1]);
+    }
 }
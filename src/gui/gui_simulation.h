@@ -17,22 +17,78 @@
 #define GUI_INPUT_DRAGGABLE_MARGIN 5 // margin between the draggable rectangle and the switch
 
 #define GUI_WIRE_THICKNESS 5
+// wires that carry a bus are thicker
+#define GUI_BUS_WIRE_THICKNESS 10
 
 #define GUI_OUTPUT_WIDTH 30
 #define GUI_OUTPUT_HEIGHT 30
 
+#define GUI_CLOCK_WIDTH 50
+#define GUI_CLOCK_HEIGHT 30
+
+// used by the flip-flop and the SR latch
+#define GUI_LATCH_WIDTH 80
+#define GUI_LATCH_HEIGHT 60
+
+#define GUI_REGISTER_WIDTH 100
+#define GUI_REGISTER_PIN_SPACING 20
+
+// the wide gates grow with their number of inputs
+#define GUI_GATE_WIDTH 80
+#define GUI_GATE_MIN_HEIGHT 40
+#define GUI_GATE_PIN_SPACING 20
+
+// the splitters and mergers are thin bars that grow with the bus width
+#define GUI_BUS_WIDTH 20
+#define GUI_BUS_PIN_SPACING 20
+
+// cycles run by gui_sim_fast_forward
+#define GUI_FAST_FORWARD_CYCLES 1000000
+
+// the ticks per second shown are measured over this many seconds
+#define GUI_RUN_MEASURE_TIME 0.5
+#define GUI_RUN_FONT_SIZE 20
+// index of 10 ticks/s in the list of rates of the run mode
+#define GUI_RUN_DEFAULT_RATE 3
+
+// files used by gui_sim_sweep, see simulation_sweep.h
+#define GUI_SWEEP_STIMULUS_PATH "stimulus.txt"
+#define GUI_SWEEP_RESULTS_PATH "results.txt"
+// written by gui_sim_fault_grade, see simulation_fault.h
+#define GUI_FAULT_REPORT_PATH "faults.txt"
+// written by gui_sim_truth_table, see simulation_truth.h
+#define GUI_TRUTH_TABLE_PATH "truth_table.txt"
+
+// random vectors used by gui_sim_check_netlist
+#define GUI_EQUIVALENCE_VECTORS (1 << 20)
+
+// snapshots skipped by a long jump in the history
+#define GUI_HISTORY_JUMP 1000
+
 #include "raylib.h"
 #include "../simulation.h"
+#include "../simulation_thread.h"
 
 typedef struct GUIChip GUIChip;
+typedef struct GUIWire GUIWire;
+
+typedef struct {
+    GUIWire **items;
+    size_t count;
+    size_t capacity;
+} GUIWireArray;
 
 typedef struct {
     size_t id;
     bool isInput;
     GUIChip *parentChip;
     SimPin *simPin;
+    // where the state of "simPin" is in gui.pinStates
+    size_t slot;
     // "global" position is calculated adding the parent position and this position
     Vector2 pos;
+    // the wires connected to the pin, so they're found without checking every wire
+    GUIWireArray wires;
 } GUIPin;
 
 typedef struct {
@@ -45,6 +101,19 @@ typedef enum {
     GUI_CHIP_INPUT,
     GUI_CHIP_NAND,
     GUI_CHIP_OUTPUT,
+    GUI_CHIP_CLOCK,
+    GUI_CHIP_DFF,
+    GUI_CHIP_SR_LATCH,
+    GUI_CHIP_REGISTER,
+    GUI_CHIP_AND,
+    GUI_CHIP_OR,
+    GUI_CHIP_XOR,
+    GUI_CHIP_NOR,
+    GUI_CHIP_XNOR,
+    GUI_CHIP_NOT,
+    GUI_CHIP_BUF,
+    GUI_CHIP_SPLITTER,
+    GUI_CHIP_MERGER,
 } GUIChipType;
 
 typedef struct {
@@ -66,19 +135,125 @@ struct GUIChip {
         GUIChipCollider draggable;
         GUIChipCollider deletable;
     } colliders;
+
+    // position in gui.chips, the chips added later are drawn on top
+    size_t order;
+    // item of the chip in gui.chips, so it's removed without searching it
+    SetItem *item;
+    // cells of the grid where the chip is, see gui_grid.h
+    struct {
+        int minX;
+        int minY;
+        int maxX;
+        int maxY;
+    } cells;
+    // the last gui_grid_query that found the chip, so it's only added once
+    size_t query;
 };
 
-typedef struct {
+struct GUIWire {
     GUIPin *src;
     GUIPin *target;
-} GUIWire;
+    // position in gui.wires
+    size_t index;
+};
 
+/*
+ * Handles the input of the chips and wires, nothing is drawn.
+ */
 void gui_sim_update(void);
 
+/*
+ * Draws the chips and wires. The ones that didn't change are drawn from a texture
+ * (see GUILayer), only the chip being dragged, its wires and the wire being made
+ * are drawn on top every frame.
+ */
+void gui_sim_draw(void);
+
+/*
+ * Adds the chip to the gui and its simulated chip to the simulation.
+ */
 void gui_sim_add_chip(GUIChip *chip);
 
+/*
+ * Removes the chip from the gui and frees its simulated chip, after its wires are deleted.
+ */
 void gui_sim_remove_chip(GUIChip *chip);
 
+/*
+ * Runs the clocks for "cycles" cycles at full speed, with "untilChange" it stops
+ * early as soon as any output chip changes. The chips show the final state once
+ * the simulation thread is done, the gui doesn't wait for it.
+ */
+void gui_sim_fast_forward(size_t cycles, bool untilChange);
+
+/*
+ * Runs "job" on a clone of the circuit in another thread (see SIM_COMMAND_JOB),
+ * the gui and the simulation thread go on meanwhile. "chips" (can be NULL) are
+ * chips of gui.sim, the job gets their clones, and the set is taken.
+ */
+void gui_sim_run_job(SimJob job, Set *chips, void *data);
+
+/*
+ * Runs GUI_SWEEP_STIMULUS_PATH over the circuit on all the processors and
+ * writes GUI_SWEEP_RESULTS_PATH. The chips on screen don't change.
+ *
+ * This and the other batch tools below run as jobs, see gui_sim_run_job.
+ */
+void gui_sim_sweep(void);
+
+/*
+ * Grades GUI_SWEEP_STIMULUS_PATH with stuck-at faults on every output pin and
+ * writes the faults each set detects to GUI_FAULT_REPORT_PATH.
+ */
+void gui_sim_fault_grade(void);
+
+/*
+ * Writes GUI_TRUTH_TABLE_PATH with the truth table of the chip under the mouse,
+ * or of the whole circuit when there's none.
+ */
+void gui_sim_truth_table(void);
+
+/*
+ * Checks with random vectors that the optimized netlist of the circuit (run by the
+ * VM, with LUTs) behaves like the plain levelized one, see simulation_equivalence.h.
+ */
+void gui_sim_check_netlist(void);
+
+/*
+ * Starts or stops ticking the clocks at the rate chosen with gui_sim_change_rate.
+ * The simulation thread runs them on its own (see SIM_COMMAND_RUN), without
+ * waiting for the frames. The history only records every SIM_THREAD_HISTORY_INTERVAL ticks.
+ */
+void gui_sim_toggle_run(void);
+
+/*
+ * Moves "steps" through the list of rates of the run mode, the last one is as
+ * fast as the simulation thread can go.
+ */
+void gui_sim_change_rate(int steps);
+
+/*
+ * Draws the rate reached by the run mode, should be called every frame outside of the camera.
+ */
+void gui_sim_update_run(void);
+
+/*
+ * Ticks the clocks and saves a snapshot in the history, on the simulation thread.
+ */
+void gui_sim_tick(void);
+
+/*
+ * Moves "steps" snapshots through the history (negative goes back in time).
+ * The history is cleared when the circuit changed since the snapshots were taken.
+ */
+void gui_sim_scrub(long steps);
+
+/*
+ * Puts the circuit in its power-on state, the history is kept.
+ */
+void gui_sim_reset(void);
+
 // ----------------- //
 // GUIPin functions //
 // ----------------- //
@@ -87,6 +262,12 @@ void gui_sim_remove_chip(GUIChip *chip);
  */
 Vector2 gui_pin_get_pos(GUIPin *pin);
 
+/*
+ * @return the state of the pin in the last snapshot of the simulation thread,
+ * PIN_HIGH, PIN_LOW or PIN_X (also for Z)
+ */
+SimPinState gui_pin_get_state(GUIPin *pin);
+
 // ----------------- //
 // GUIWire functions //
 // ----------------- //
@@ -94,8 +275,15 @@ GUIWire *gui_wire_new();
 
 void gui_wire_free(GUIWire *wire);
 
+/*
+ * Adds the finished wire to gui.wires and to the wires of its pins.
+ * The pins should already be connected in the simulation.
+ */
+void gui_wire_add(GUIWire *wire);
+
 /*
  * Deletes all wires that have the pin in either "target" or "src" fields.
+ * Only the wires of the pin are checked, not every wire.
  */
 void gui_wire_delete_by_pin(GUIPin *pin);
 
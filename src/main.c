@@ -4,42 +4,206 @@
 
 #include "simulation.h"
 #include "simulation_debug.h"
+#include "simulation_netlist.h"
 #include "gui/gui.h"
 #include "gui/gui_chip.h"
 #include "raylib.h"
 
-#define BG_COLOR CLITERAL(Color){ 16, 14, 23, 255 }
+#ifdef DEBUG
+// the debug keys read a clone of the circuit in another thread, see gui_sim_run_job
+static void print_context(SimContext *context, Set *chips, void *data) {
+    (void)chips;
+    (void)data;
+    sim_debug_print(context);
+}
+
+static void print_chip_count(SimContext *context, Set *chips, void *data) {
+    (void)chips;
+    (void)data;
+    TraceLog(LOG_INFO, "Simulation chips count: %lu", context->chips->count);
+}
+
+static void print_netlist(SimContext *context, Set *chips, void *data) {
+    (void)chips;
+    (void)data;
+    SimNetlist *netlist = sim_netlist_compile(context->chips, (SimNetlistOptions){
+        .optimize = true,
+        .collapseLuts = true,
+    });
+    sim_debug_print_netlist(netlist);
+    sim_netlist_free(netlist);
+}
+#endif
 
 int main() {
     InitWindow(1280, 720, "Logic Simulator");
     SetTargetFPS(60);
 
-    sim_init();
-    gui_init();
+    gui_init(sim_context_new());
 
+    // the frames are only drawn when something can change, otherwise the loop
+    // sleeps until there's an input
+    size_t busyFrames = GUI_BUSY_FRAMES;
     while(!WindowShouldClose()) {
+        if(gui_has_input()) busyFrames = GUI_BUSY_FRAMES;
+        if(busyFrames == 0) {
+            EnableEventWaiting();
+            PollInputEvents();
+            continue;
+        }
+
+        // EndDrawing waits for the next input after the last busy frame
+        busyFrames--;
+        if(busyFrames == 0) {
+            EnableEventWaiting();
+        } else {
+            DisableEventWaiting();
+        }
+
         BeginDrawing();
-        ClearBackground(BG_COLOR);
+        ClearBackground(GUI_BG_COLOR);
 
 #ifdef DEBUG
         if(IsKeyPressed(KEY_D) && IsKeyDown(KEY_LEFT_CONTROL)) {
-            sim_debug_print(simulation);
+            gui_sim_run_job(print_context, NULL, NULL);
         } else if(IsKeyPressed(KEY_D)) {
-            TraceLog(LOG_INFO, "Simulation chips count: %lu", simulation.chips->count);
+            gui_sim_run_job(print_chip_count, NULL, NULL);
             TraceLog(LOG_INFO, "GUI chips count: %lu", gui.chips->count);
         }
+
+        if(IsKeyPressed(KEY_L)) {
+            gui_sim_run_job(print_netlist, NULL, NULL);
+        }
 #endif
 
         if(IsKeyPressed(KEY_N)) {
-            gui_sim_add_chip(gui_chip_new(GUI_CHIP_NAND, GetMousePosition()));
+            gui_sim_add_chip(gui_chip_new(GUI_CHIP_NAND, gui_mouse_pos()));
         }
 
         if(IsKeyPressed(KEY_I)) {
-            gui_sim_add_chip(gui_chip_new(GUI_CHIP_INPUT, GetMousePosition()));
+            gui_sim_add_chip(gui_chip_new(GUI_CHIP_INPUT, gui_mouse_pos()));
         }
 
         if(IsKeyPressed(KEY_O)) {
-            gui_sim_add_chip(gui_chip_new(GUI_CHIP_OUTPUT, GetMousePosition()));
+            gui_sim_add_chip(gui_chip_new(GUI_CHIP_OUTPUT, gui_mouse_pos()));
+        }
+
+        if(IsKeyPressed(KEY_C)) {
+            gui_sim_add_chip(gui_chip_new(GUI_CHIP_CLOCK, gui_mouse_pos()));
+        }
+
+        if(IsKeyPressed(KEY_ONE)) {
+            gui_sim_add_chip(gui_chip_new(GUI_CHIP_DFF, gui_mouse_pos()));
+        }
+
+        if(IsKeyPressed(KEY_TWO)) {
+            gui_sim_add_chip(gui_chip_new(GUI_CHIP_SR_LATCH, gui_mouse_pos()));
+        }
+
+        if(IsKeyPressed(KEY_THREE)) {
+            gui_sim_add_chip(gui_chip_new(GUI_CHIP_REGISTER, gui_mouse_pos()));
+        }
+
+        if(IsKeyPressed(KEY_A)) {
+            gui_sim_add_chip(gui_chip_new_gate(GUI_CHIP_AND, gui.gateInputs, gui_mouse_pos()));
+        }
+
+        // with shift the inverted gate is added
+        if(IsKeyPressed(KEY_R)) {
+            GUIChipType type = IsKeyDown(KEY_LEFT_SHIFT) ? GUI_CHIP_NOR : GUI_CHIP_OR;
+            gui_sim_add_chip(gui_chip_new_gate(type, gui.gateInputs, gui_mouse_pos()));
+        }
+
+        if(IsKeyPressed(KEY_X)) {
+            GUIChipType type = IsKeyDown(KEY_LEFT_SHIFT) ? GUI_CHIP_XNOR : GUI_CHIP_XOR;
+            gui_sim_add_chip(gui_chip_new_gate(type, gui.gateInputs, gui_mouse_pos()));
+        }
+
+        if(IsKeyPressed(KEY_T)) {
+            gui_sim_add_chip(gui_chip_new(GUI_CHIP_NOT, gui_mouse_pos()));
+        }
+
+        if(IsKeyPressed(KEY_B)) {
+            gui_sim_add_chip(gui_chip_new(GUI_CHIP_BUF, gui_mouse_pos()));
+        }
+
+        if(IsKeyPressed(KEY_S)) {
+            gui_sim_add_chip(gui_chip_new_bus(GUI_CHIP_SPLITTER, gui.busWidth, gui_mouse_pos()));
+        }
+
+        if(IsKeyPressed(KEY_M)) {
+            gui_sim_add_chip(gui_chip_new_bus(GUI_CHIP_MERGER, gui.busWidth, gui_mouse_pos()));
+        }
+
+        if(IsKeyPressed(KEY_EQUAL) && gui.gateInputs < SIM_GATE_MAX_INPUTS) {
+            gui.gateInputs++;
+            TraceLog(LOG_INFO, "Gates will have %zu inputs", gui.gateInputs);
+        }
+
+        if(IsKeyPressed(KEY_MINUS) && gui.gateInputs > 1) {
+            gui.gateInputs--;
+            TraceLog(LOG_INFO, "Gates will have %zu inputs", gui.gateInputs);
+        }
+
+        if(IsKeyPressed(KEY_RIGHT_BRACKET) && gui.busWidth < SIM_BUS_MAX_WIDTH) {
+            gui.busWidth++;
+            TraceLog(LOG_INFO, "Buses will have %zu bits", gui.busWidth);
+        }
+
+        if(IsKeyPressed(KEY_LEFT_BRACKET) && gui.busWidth > 2) {
+            gui.busWidth--;
+            TraceLog(LOG_INFO, "Buses will have %zu bits", gui.busWidth);
+        }
+
+        // half a cycle
+        if(IsKeyPressed(KEY_SPACE)) {
+            gui_sim_tick();
+        }
+
+        if(IsKeyPressed(KEY_P)) {
+            gui_sim_toggle_run();
+        }
+
+        if(IsKeyPressed(KEY_UP)) {
+            gui_sim_change_rate(1);
+        }
+
+        if(IsKeyPressed(KEY_DOWN)) {
+            gui_sim_change_rate(-1);
+        }
+
+        // with shift it jumps through the history
+        if(IsKeyPressed(KEY_LEFT) || IsKeyPressedRepeat(KEY_LEFT)) {
+            gui_sim_scrub(IsKeyDown(KEY_LEFT_SHIFT) ? -GUI_HISTORY_JUMP : -1);
+        }
+
+        if(IsKeyPressed(KEY_RIGHT) || IsKeyPressedRepeat(KEY_RIGHT)) {
+            gui_sim_scrub(IsKeyDown(KEY_LEFT_SHIFT) ? GUI_HISTORY_JUMP : 1);
+        }
+
+        if(IsKeyPressed(KEY_HOME)) {
+            gui_sim_reset();
+        }
+
+        // with shift it stops as soon as an output changes
+        if(IsKeyPressed(KEY_F)) {
+            gui_sim_fast_forward(GUI_FAST_FORWARD_CYCLES, IsKeyDown(KEY_LEFT_SHIFT));
+        }
+
+        if(IsKeyPressed(KEY_V)) {
+            gui_sim_sweep();
+        }
+
+        if(IsKeyPressed(KEY_G)) {
+            gui_sim_fault_grade();
+        }
+
+        if(IsKeyPressed(KEY_E)) {
+            gui_sim_truth_table();
+        }
+
+        if(IsKeyPressed(KEY_Q)) {
+            gui_sim_check_netlist();
         }
 
         gui_update();
@@ -49,5 +213,8 @@ int main() {
 
     CloseWindow();
 
+    // the jobs are left to end, so their files aren't cut off
+    sim_thread_stop(gui.simThread);
+
     return 0;
 }
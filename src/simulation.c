@@ -1,25 +1,137 @@
 #include "simulation.h"
+#include "simulation_snapshot.h"
 
-Simulation simulation = {0};
+SimContext *sim_context_new(void) {
+    SimContext *context = alloc(sizeof(SimContext));
+    context->chips = set_new();
+    return context;
+}
+
+static void context_destroy(SimContext *context, bool freeChips) {
+    for(SetItem *item = context->chips->head; item != NULL; item = item->next) {
+        SimChip *chip = item->data;
+        if(freeChips) {
+            sim_chip_free(chip);
+        } else {
+            chip->context = NULL;
+        }
+    }
+    set_clear_and_destroy(context->chips);
+    if(context->shadow != NULL) sim_snapshot_free(context->shadow);
+    free(context);
+}
+
+void sim_context_free(SimContext *context) {
+    context_destroy(context, false);
+}
+
+static void copy_pin_array(SimPinArray *dst, SimPinArray *src, SimChip *parentChip) {
+    for(size_t i = 0; i < src->count; i++) {
+        SimPin pin = src->items[i];
+        pin.parentChip = parentChip;
+        pin.connectedPins = set_new();
+        da_append(dst, pin);
+    }
+}
+
+static SimChip *chip_copy(SimChip *chip) {
+    SimChip *copy = alloc(sizeof(SimChip));
+    copy->type = chip->type;
+    copy_pin_array(&copy->inputs, &chip->inputs, copy);
+    copy_pin_array(&copy->outputs, &chip->outputs, copy);
 
-void sim_init(void) {
-    simulation.chips = set_new();
+    if(chip->stored != NULL) {
+        copy->stored = alloc(chip->outputs.count*sizeof(SimPinState));
+        for(size_t i = 0; i < chip->outputs.count; i++) {
+            copy->stored[i] = chip->stored[i];
+        }
+    }
+
+    return copy;
 }
 
-void sim_add_chip(SimChip *chip) {
-    set_add(simulation.chips, chip);
+// copies the chips of "context" that are in "selected", or all of them when it's NULL
+static SimContext *clone_chips(SimContext *context, Map *selected) {
+    SimContext *clone = sim_context_new();
+
+    // the chips keep their order, so the netlists of both contexts are the same
+    Map *chipIndexes = map_new();
+    SimChip **copies = alloc((context->chips->count + 1)*sizeof(SimChip *));
+    size_t count = 0;
+    for(SetItem *item = context->chips->head; item != NULL; item = item->next) {
+        size_t unused;
+        if(selected != NULL && !map_get(selected, item->data, &unused)) continue;
+        map_set(chipIndexes, item->data, count);
+        copies[count] = chip_copy(item->data);
+        sim_add_chip(clone, copies[count]);
+        count++;
+    }
+
+    // the states were copied too, so the connections are added without propagating anything
+    for(SetItem *item = context->chips->head; item != NULL; item = item->next) {
+        SimChip *chip = item->data;
+        size_t chipIndex;
+        if(!map_get(chipIndexes, chip, &chipIndex)) continue;
+
+        for(size_t i = 0; i < chip->outputs.count; i++) {
+            SimPin *src = &copies[chipIndex]->outputs.items[i];
+            for(SetItem *pinItem = chip->outputs.items[i].connectedPins->head; pinItem != NULL; pinItem = pinItem->next) {
+                SimPin *target = pinItem->data;
+                size_t index;
+                // a connection to a chip outside the context is lost
+                if(!map_get(chipIndexes, target->parentChip, &index)) continue;
+                SimChip *targetCopy = copies[index];
+                set_add(src->connectedPins, &targetCopy->inputs.items[target - target->parentChip->inputs.items]);
+            }
+        }
+    }
+
+    map_free(chipIndexes);
+    free(copies);
+    return clone;
 }
 
-void sim_remove_chip(SimChip *chip) {
-    set_delete(simulation.chips, chip);
+SimContext *sim_context_clone(SimContext *context) {
+    SimContext *clone = clone_chips(context, NULL);
+    clone->topology = context->topology;
+    return clone;
+}
+
+SimContext *sim_context_clone_chips(SimContext *context, Set *chips) {
+    Map *selected = map_new();
+    for(SetItem *item = chips->head; item != NULL; item = item->next) {
+        map_set(selected, item->data, 0);
+    }
+
+    SimContext *clone = clone_chips(context, selected);
+    map_free(selected);
+    return clone;
+}
+
+void sim_context_free_chips(SimContext *context) {
+    context_destroy(context, true);
+}
+
+void sim_add_chip(SimContext *context, SimChip *chip) {
+    chip->item = set_add(context->chips, chip);
+    chip->context = context;
+    context->topology++;
+}
+
+void sim_remove_chip(SimContext *context, SimChip *chip) {
+    set_delete_item(context->chips, chip->item);
+    chip->item = NULL;
+    chip->context = NULL;
+    context->topology++;
 }
 
 static void chip_add_input_pin(SimChip *chip) {
     da_append(&chip->inputs, ((SimPin){
         .isInput = true,
         .parentChip = chip,
-        .state = PIN_LOW,
+        .state = PIN_Z,
         .connectedPins = set_new(),
+        .width = 1,
     }));
 }
 
@@ -27,11 +139,41 @@ static void chip_add_output_pin(SimChip *chip) {
     da_append(&chip->outputs, ((SimPin){
         .isInput = false,
         .parentChip = chip,
-        .state = PIN_LOW,
+        .state = PIN_X,
         .connectedPins = set_new(),
+        .width = 1,
     }));
 }
 
+// the bus is the input of a splitter and the output of a merger, its bits start unknown
+static void chip_add_bus_pins(SimChip *chip, size_t width) {
+    bool isSplitter = chip->type == SIM_CHIP_SPLITTER;
+    da_append(isSplitter ? &chip->inputs : &chip->outputs, ((SimPin){
+        .isInput = isSplitter,
+        .parentChip = chip,
+        .state = PIN_X,
+        .connectedPins = set_new(),
+        .width = width,
+    }));
+
+    for(size_t i = 0; i < width; i++) {
+        if(isSplitter) {
+            chip_add_output_pin(chip);
+        } else {
+            chip_add_input_pin(chip);
+        }
+    }
+}
+
+static uint64_t get_bus_mask(size_t width) {
+    return width == 64 ? ~0llu : (1llu << width) - 1;
+}
+
+static void chip_add_pins(SimChip *chip, size_t inputs, size_t outputs) {
+    for(size_t i = 0; i < inputs; i++) chip_add_input_pin(chip);
+    for(size_t i = 0; i < outputs; i++) chip_add_output_pin(chip);
+}
+
 SimChip *sim_chip_new(SimChipType type) {
     SimChip *chip = alloc(sizeof(SimChip));
     chip->type = type;
@@ -41,20 +183,100 @@ SimChip *sim_chip_new(SimChipType type) {
             chip_add_input_pin(chip);
             chip_add_input_pin(chip);
             chip_add_output_pin(chip);
-
-            chip->outputs.items[0].state = PIN_HIGH;
             break;
         case SIM_CHIP_INPUT:
+        case SIM_CHIP_CLOCK:
             chip_add_output_pin(chip);
+            chip->outputs.items[0].state = PIN_LOW;
             break;
         case SIM_CHIP_OUTPUT:
             chip_add_input_pin(chip);
             break;
+        case SIM_CHIP_DFF:
+        case SIM_CHIP_SR_LATCH:
+            chip_add_pins(chip, 2, 1);
+            break;
+        case SIM_CHIP_REGISTER:
+            chip_add_pins(chip, SIM_REGISTER_WIDTH + 2, SIM_REGISTER_WIDTH);
+            break;
+        case SIM_CHIP_AND:
+        case SIM_CHIP_OR:
+        case SIM_CHIP_XOR:
+        case SIM_CHIP_NOR:
+        case SIM_CHIP_XNOR:
+            chip_add_pins(chip, SIM_GATE_DEFAULT_INPUTS, 1);
+            break;
+        case SIM_CHIP_NOT:
+        case SIM_CHIP_BUF:
+            chip_add_pins(chip, 1, 1);
+            break;
+        case SIM_CHIP_SPLITTER:
+        case SIM_CHIP_MERGER:
+            chip_add_bus_pins(chip, SIM_BUS_DEFAULT_WIDTH);
+            break;
     }
 
+    if(sim_chip_is_sequential(chip)) {
+        // like the outputs, the state is unknown until something is stored
+        chip->stored = alloc(chip->outputs.count*sizeof(SimPinState));
+        for(size_t i = 0; i < chip->outputs.count; i++) {
+            chip->stored[i] = PIN_X;
+        }
+    }
+
+    return chip;
+}
+
+SimChip *sim_chip_new_gate(SimChipType type, size_t inputCount) {
+    assert(inputCount > 0 && inputCount <= SIM_GATE_MAX_INPUTS && "Invalid number of inputs");
+
+    SimChip *chip = sim_chip_new(type);
+    assert(sim_chip_is_wide_gate(chip) && "The chip is not a wide gate");
+    for(size_t i = chip->inputs.count; i < inputCount; i++) {
+        chip_add_input_pin(chip);
+    }
+    // the pins are only removed from the end
+    while(chip->inputs.count > inputCount) {
+        set_clear_and_destroy(chip->inputs.items[--chip->inputs.count].connectedPins);
+    }
+
+    return chip;
+}
+
+SimChip *sim_chip_new_bus(SimChipType type, size_t width) {
+    assert((type == SIM_CHIP_SPLITTER || type == SIM_CHIP_MERGER) && "The chip is not a splitter or a merger");
+    assert(width > 1 && width <= SIM_BUS_MAX_WIDTH && "Invalid bus width");
+
+    SimChip *chip = alloc(sizeof(SimChip));
+    chip->type = type;
+    chip_add_bus_pins(chip, width);
     return chip;
 }
 
+bool sim_chip_is_wide_gate(SimChip *chip) {
+    switch(chip->type) {
+        case SIM_CHIP_AND:
+        case SIM_CHIP_OR:
+        case SIM_CHIP_XOR:
+        case SIM_CHIP_NOR:
+        case SIM_CHIP_XNOR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool sim_chip_is_sequential(SimChip *chip) {
+    switch(chip->type) {
+        case SIM_CHIP_DFF:
+        case SIM_CHIP_SR_LATCH:
+        case SIM_CHIP_REGISTER:
+            return true;
+        default:
+            return false;
+    }
+}
+
 static void free_pin_array(SimPinArray *pinArr) {
     for(size_t i = 0; i < pinArr->count; i++) {
         SimPin pin = pinArr->items[i];
@@ -67,6 +289,7 @@ static void free_pin_array(SimPinArray *pinArr) {
 void sim_chip_free(SimChip *chip) {
     free_pin_array(&chip->inputs);
     free_pin_array(&chip->outputs);
+    free(chip->stored);
     free(chip);
 }
 
@@ -87,32 +310,215 @@ SimPin *sim_chip_get_output_pin(SimChip *chip, size_t index) {
 }
 
 static void update_pin_state(SimPin *pin, SimPinState state);
+static void update_bus_state(SimPin *pin, SimLogic bits);
+
+static SimLogic state_to_logic(SimPinState state) {
+    return (SimLogic){
+        .high = state == PIN_HIGH,
+        .low = state == PIN_LOW,
+    };
+}
+
+static SimPinState logic_to_state(SimLogic logic) {
+    if(logic.high & 1) return PIN_HIGH;
+    if(logic.low & 1) return PIN_LOW;
+    return PIN_X;
+}
+
+// the value a flip-flop stores when it reads "state", Z is stored as X
+static SimPinState stored_state(SimPinState state) {
+    return state == PIN_Z ? PIN_X : state;
+}
+
+static SimPinState update_sr_latch(SimPinState set, SimPinState reset, SimPinState stored) {
+    if(set == PIN_LOW && reset == PIN_LOW) return stored;
+    if(set == PIN_HIGH && reset == PIN_LOW) return PIN_HIGH;
+    if(set == PIN_LOW && reset == PIN_HIGH) return PIN_LOW;
+    return PIN_X;
+}
+
+static bool is_clock_pin(SimPin *pin) {
+    SimChip *chip = pin->parentChip;
+    if(chip->type != SIM_CHIP_DFF && chip->type != SIM_CHIP_REGISTER) return false;
+    // the clock is always the last input
+    return pin == &chip->inputs.items[chip->inputs.count - 1];
+}
+
+// stores the inputs of a flip-flop or register, it's called on the rising edge
+// of the clock before any output changes
+static void clock_chip(SimChip *chip) {
+    if(chip->type == SIM_CHIP_DFF) {
+        chip->stored[0] = stored_state(chip->inputs.items[0].state);
+        return;
+    }
+
+    SimPinState enable = chip->inputs.items[SIM_REGISTER_WIDTH].state;
+    if(enable == PIN_LOW) return;
+    for(size_t i = 0; i < SIM_REGISTER_WIDTH; i++) {
+        SimPinState data = stored_state(chip->inputs.items[i].state);
+        if(enable == PIN_HIGH || data == chip->stored[i]) {
+            chip->stored[i] = data;
+        } else {
+            // we don't know if it was loaded or not
+            chip->stored[i] = PIN_X;
+        }
+    }
+}
+
+static SimLogic eval_gate(SimChip *chip) {
+    SimLogic result = state_to_logic(chip->inputs.items[0].state);
+    for(size_t i = 1; i < chip->inputs.count; i++) {
+        SimLogic input = state_to_logic(chip->inputs.items[i].state);
+        switch(chip->type) {
+            case SIM_CHIP_NAND:
+            case SIM_CHIP_AND:
+                result = sim_logic_and(result, input);
+                break;
+            case SIM_CHIP_OR:
+            case SIM_CHIP_NOR:
+                result = sim_logic_or(result, input);
+                break;
+            case SIM_CHIP_XOR:
+            case SIM_CHIP_XNOR:
+                result = sim_logic_xor(result, input);
+                break;
+            default: break;
+        }
+    }
+
+    switch(chip->type) {
+        case SIM_CHIP_NAND:
+        case SIM_CHIP_NOR:
+        case SIM_CHIP_XNOR:
+        case SIM_CHIP_NOT:
+            return sim_logic_not(result);
+        default:
+            return result;
+    }
+}
+
+static void update_splitter(SimChip *chip) {
+    for(size_t i = 0; i < chip->outputs.count; i++) {
+        // the bus is read again for every bit, updating an output can change it
+        SimLogic bits = chip->inputs.items[0].bits;
+        SimPinState state = logic_to_state((SimLogic){ .high = bits.high >> i, .low = bits.low >> i });
+        if(chip->outputs.items[i].state != state) {
+            update_pin_state(&chip->outputs.items[i], state);
+        }
+    }
+}
+
+static void update_merger(SimChip *chip) {
+    SimLogic bits = {0};
+    for(size_t i = 0; i < chip->inputs.count; i++) {
+        SimLogic bit = state_to_logic(chip->inputs.items[i].state);
+        bits.high |= (bit.high & 1) << i;
+        bits.low |= (bit.low & 1) << i;
+    }
+
+    SimPin *output = &chip->outputs.items[0];
+    if(output->bits.high != bits.high || output->bits.low != bits.low) {
+        update_bus_state(output, bits);
+    }
+}
 
 static void update_chip_state(SimChip *chip) {
     switch(chip->type) {
+        case SIM_CHIP_SPLITTER:
+            update_splitter(chip);
+            break;
+        case SIM_CHIP_MERGER:
+            update_merger(chip);
+            break;
         case SIM_CHIP_NAND:
+        case SIM_CHIP_AND:
+        case SIM_CHIP_OR:
+        case SIM_CHIP_XOR:
+        case SIM_CHIP_NOR:
+        case SIM_CHIP_XNOR:
+        case SIM_CHIP_NOT:
+        case SIM_CHIP_BUF:
             SimPin *output = &chip->outputs.items[0];
-            SimPinState state = !(chip->inputs.items[0].state & chip->inputs.items[1].state);
+            SimPinState state = logic_to_state(eval_gate(chip));
             if(state != output->state) {
                 update_pin_state(output, state);
             }
             break;
+        case SIM_CHIP_SR_LATCH:
+            chip->stored[0] = update_sr_latch(chip->inputs.items[0].state, chip->inputs.items[1].state, chip->stored[0]);
+            break;
         default: break;
     }
+
+    if(chip->stored == NULL) return;
+    for(size_t i = 0; i < chip->outputs.count; i++) {
+        if(chip->outputs.items[i].state != chip->stored[i]) {
+            update_pin_state(&chip->outputs.items[i], chip->stored[i]);
+        }
+    }
+}
+
+static bool is_clock_edge(SimPin *pin, SimPinState state) {
+    return pin->state == PIN_LOW && state == PIN_HIGH && is_clock_pin(pin);
 }
 
 static void update_pin_state(SimPin *pin, SimPinState state) {
+    if(pin->isInput) {
+        if(is_clock_edge(pin, state)) clock_chip(pin->parentChip);
+        pin->state = state;
+        update_chip_state(pin->parentChip);
+        return;
+    }
+
     pin->state = state;
 
+    // the flip-flops clocked by this pin store their inputs before any connected pin
+    // changes, this way the ones that share a clock all read the values from before
+    // the edge, even a data input wired to the clock itself
+    SetItem *item = pin->connectedPins->head;
+    while(item != NULL) {
+        if(is_clock_edge(item->data, state)) {
+            clock_chip(((SimPin *)item->data)->parentChip);
+        }
+        item = item->next;
+    }
+
+    item = pin->connectedPins->head;
+    while(item != NULL) {
+        SimPin *pin = item->data;
+        pin->state = state;
+        item = item->next;
+    }
+
+    item = pin->connectedPins->head;
+    while(item != NULL) {
+        SimPin *pin = item->data;
+        update_chip_state(pin->parentChip);
+        item = item->next;
+    }
+}
+
+// a whole word goes through the bus in a single update
+static void update_bus_state(SimPin *pin, SimLogic bits) {
+    pin->bits = bits;
+
     if(pin->isInput) {
         update_chip_state(pin->parentChip);
-    } else {
-        SetItem *item = pin->connectedPins->head;
-        while(item != NULL) {
-            SimPin *pin = item->data;
-            update_pin_state(pin, state);
-            item = item->next;
-        }
+        return;
+    }
+
+    SetItem *item = pin->connectedPins->head;
+    while(item != NULL) {
+        SimPin *pin = item->data;
+        pin->bits = bits;
+        item = item->next;
+    }
+
+    item = pin->connectedPins->head;
+    while(item != NULL) {
+        SimPin *pin = item->data;
+        update_chip_state(pin->parentChip);
+        item = item->next;
     }
 }
 
@@ -124,23 +530,109 @@ bool sim_chip_toggle_output_pin(SimChip *chip, size_t index) {
     return true;
 }
 
+void sim_clock_tick(SimContext *context) {
+    SetItem *item = context->chips->head;
+    while(item != NULL) {
+        SimChip *chip = item->data;
+        if(chip->type == SIM_CHIP_CLOCK) {
+            sim_chip_toggle_output_pin(chip, 0);
+        }
+        item = item->next;
+    }
+}
+
+static void reset_pin_array(SimPinArray *pins, SimPinState state) {
+    for(size_t i = 0; i < pins->count; i++) {
+        pins->items[i].state = state;
+        pins->items[i].bits = (SimLogic){0};
+    }
+}
+
+// the connected input pins read the state of the output pin
+static void push_output_pins(SimChip *chip) {
+    for(size_t i = 0; i < chip->outputs.count; i++) {
+        SimPin *pin = &chip->outputs.items[i];
+        for(SetItem *item = pin->connectedPins->head; item != NULL; item = item->next) {
+            SimPin *target = item->data;
+            target->state = pin->state;
+            target->bits = pin->bits;
+        }
+    }
+}
+
+void sim_reset(SimContext *context) {
+    // first every pin goes back to the state of a new chip
+    for(SetItem *item = context->chips->head; item != NULL; item = item->next) {
+        SimChip *chip = item->data;
+        reset_pin_array(&chip->inputs, PIN_Z);
+        bool isSource = chip->type == SIM_CHIP_INPUT || chip->type == SIM_CHIP_CLOCK;
+        reset_pin_array(&chip->outputs, isSource ? PIN_LOW : PIN_X);
+        if(chip->type == SIM_CHIP_SPLITTER) chip->inputs.items[0].state = PIN_X;
+        if(chip->type == SIM_CHIP_MERGER) chip->outputs.items[0].state = PIN_X;
+
+        if(chip->stored != NULL) {
+            for(size_t i = 0; i < chip->outputs.count; i++) {
+                chip->stored[i] = PIN_X;
+            }
+        }
+    }
+
+    for(SetItem *item = context->chips->head; item != NULL; item = item->next) {
+        push_output_pins(item->data);
+    }
+
+    // then every chip is updated once, any change goes on from there like it does
+    // when the pins are connected
+    for(SetItem *item = context->chips->head; item != NULL; item = item->next) {
+        update_chip_state(item->data);
+    }
+}
+
+// the connections are part of the topology of the contexts of both chips
+static void touch_topology(SimPin *src, SimPin *target) {
+    SimContext *srcContext = src->parentChip->context;
+    SimContext *targetContext = target->parentChip->context;
+    if(srcContext != NULL) srcContext->topology++;
+    if(targetContext != NULL && targetContext != srcContext) targetContext->topology++;
+}
+
 bool sim_pin_add_connection(SimPin *src, SimPin *target) {
     if(src->isInput) {
         // TODO: implement a good logger
         printf("[ERROR] Target pin is an Input Pin");
         return false;
     }
+    if(src->width != target->width) {
+        printf("[ERROR] Can't connect a pin of %zu bits to one of %zu bits\n", src->width, target->width);
+        return false;
+    }
 
-    update_pin_state(target, src->state);
+    if(target->width > 1) {
+        update_bus_state(target, src->bits);
+    } else {
+        update_pin_state(target, src->state);
+    }
     set_add(src->connectedPins, target);
+    touch_topology(src, target);
     return true;
 }
 
 bool sim_pin_remove_connection(SimPin *src, SimPin *target) {
-    update_pin_state(target, PIN_LOW);
+    if(target->width > 1) {
+        update_bus_state(target, (SimLogic){0});
+    } else {
+        update_pin_state(target, PIN_Z);
+    }
+    touch_topology(src, target);
     return set_delete(src->connectedPins, target);
 }
 
 bool sim_pin_is_high(SimPin *pin) {
+    if(pin->width > 1) return (pin->bits.high & get_bus_mask(pin->width)) != 0;
     return pin->state == PIN_HIGH;
 }
+
+bool sim_pin_is_unknown(SimPin *pin) {
+    if(pin->width > 1) return (sim_logic_unknown(pin->bits) & get_bus_mask(pin->width)) != 0;
+    return pin->state & PIN_Z;
+}
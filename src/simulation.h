@@ -3,13 +3,20 @@
 
 #include <stdbool.h>
 #include "utils.h"
+#include "simulation_logic.h"
 
 typedef struct SimChip SimChip;
+typedef struct SimContext SimContext;
+typedef struct SimSnapshot SimSnapshot;
 
-// NOTE: should it be a boolean instead of an enum?
+// bit 0 is the value and bit 1 says the value is unknown
 typedef enum {
     PIN_LOW = 0,
-    PIN_HIGH,
+    PIN_HIGH = 1,
+    // high impedance, the pin isn't connected to anything
+    PIN_Z = 2,
+    // unknown, e.g. a latch that was never set
+    PIN_X = 3,
 } SimPinState;
 
 typedef struct {
@@ -17,6 +24,10 @@ typedef struct {
     SimChip *parentChip;
     Set *connectedPins;
     SimPinState state;
+    // number of bits, a pin with more than one is a bus and its value is in "bits"
+    // instead of "state" (bit "i" of both planes is the bit "i" of the bus)
+    size_t width;
+    SimLogic bits;
 } SimPin;
 
 typedef struct {
@@ -29,33 +40,113 @@ typedef enum {
     SIM_CHIP_NAND,
     SIM_CHIP_INPUT,
     SIM_CHIP_OUTPUT,
+    // an input that is toggled by the simulation instead of the user
+    SIM_CHIP_CLOCK,
+    // inputs: D, CLK. Q takes the value of D on the rising edge of CLK
+    SIM_CHIP_DFF,
+    // inputs: S, R. Q goes HIGH with S, LOW with R and it's X when both are HIGH
+    SIM_CHIP_SR_LATCH,
+    // inputs: D0..D7, EN, CLK. Like SIM_REGISTER_WIDTH flip-flops that only load when EN is HIGH
+    SIM_CHIP_REGISTER,
+    // gates with any number of inputs, see sim_chip_new_gate
+    SIM_CHIP_AND,
+    SIM_CHIP_OR,
+    SIM_CHIP_XOR,
+    SIM_CHIP_NOR,
+    SIM_CHIP_XNOR,
+    // gates with a single input
+    SIM_CHIP_NOT,
+    SIM_CHIP_BUF,
+    // splits a bus input into one output per bit, see sim_chip_new_bus
+    SIM_CHIP_SPLITTER,
+    // joins one input per bit into a bus output
+    SIM_CHIP_MERGER,
 } SimChipType;
 
+#define SIM_REGISTER_WIDTH 8
+
+#define SIM_GATE_DEFAULT_INPUTS 2
+#define SIM_GATE_MAX_INPUTS 64
+
+#define SIM_BUS_DEFAULT_WIDTH 8
+#define SIM_BUS_MAX_WIDTH 64
+
 struct SimChip {
     SimChipType type;
     SimPinArray inputs;
     SimPinArray outputs;
+    // value kept by the sequential chips for each output, NULL for the rest
+    SimPinState *stored;
+    // the context the chip was added to, NULL when it's in none
+    SimContext *context;
+    // item of the chip in context->chips, so it's removed without searching it
+    SetItem *item;
 };
 
-typedef struct {
+/*
+ * An independent simulation. Nothing is shared between contexts, so each one
+ * can run on its own thread, as long as a context (and its chips) is only used
+ * by one thread at a time and the chips of different contexts aren't connected.
+ */
+struct SimContext {
     Set *chips;
-} Simulation;
+    // changes every time a chip or a connection is added or removed
+    size_t topology;
+    // pages of the last snapshot taken or restored, see simulation_snapshot.h
+    SimSnapshot *shadow;
+};
+
+SimContext *sim_context_new(void);
+
+/*
+ * It doesn't free the chips of the context.
+ */
+void sim_context_free(SimContext *context);
 
-extern Simulation simulation;
+/*
+ * Creates a new context with a copy of every chip, connection and pin state of
+ * "context". The copies are independent, so they can be run on other threads.
+ * Should be freed with sim_context_free_chips.
+ */
+SimContext *sim_context_clone(SimContext *context);
+
+/*
+ * Same as sim_context_clone but only copies the chips of the context that are in
+ * "chips", in the order of the context. The connections with the chips that aren't
+ * copied are lost, so those input pins are left as they are.
+ */
+SimContext *sim_context_clone_chips(SimContext *context, Set *chips);
 
 /*
- * Initializes necessary data into the variable "simulation."
- * Should be called before any other function from this file.
+ * Frees the context together with all its chips.
  */
-void sim_init(void);
+void sim_context_free_chips(SimContext *context);
 
-void sim_add_chip(SimChip *chip);
+void sim_add_chip(SimContext *context, SimChip *chip);
 
 /*
- * Removes the chip from the Simulation "chips" set.
+ * Removes the chip from the context "chips" set.
  * It doesn't free the chip or remove the connections between pins.
  */
-void sim_remove_chip(SimChip *chip);
+void sim_remove_chip(SimContext *context, SimChip *chip);
+
+/*
+ * Puts every chip back in the state it has when it's created (power-on), keeping
+ * the connections, and propagates it like when the circuit was built.
+ */
+void sim_reset(SimContext *context);
+
+/*
+ * Toggles the output of every SIM_CHIP_CLOCK, two ticks are a full cycle.
+ *
+ * The changes propagate one pin at a time, so a flip-flop only stores its inputs
+ * from before the edge when its clock pin is wired straight to the output that
+ * changes. When the clock goes through gates (e.g. CLK=BUF(clock)) and a data input
+ * depends on the clock too (e.g. D=NOT(clock)), the data can change first and what's
+ * stored depends on the order of the connections. The netlists always store the
+ * values from before the edge (see simulation_netlist.h), so they can differ there.
+ */
+void sim_clock_tick(SimContext *context);
 
 // ------------------------- //
 // SimChip related functions //
@@ -63,6 +154,28 @@ void sim_remove_chip(SimChip *chip);
 
 SimChip *sim_chip_new(SimChipType type);
 
+/*
+ * Creates an AND, OR, XOR, NOR or XNOR gate with "inputCount" inputs,
+ * sim_chip_new creates them with SIM_GATE_DEFAULT_INPUTS.
+ */
+SimChip *sim_chip_new_gate(SimChipType type, size_t inputCount);
+
+/*
+ * Creates a splitter or a merger for a bus of "width" bits,
+ * sim_chip_new creates them with SIM_BUS_DEFAULT_WIDTH.
+ */
+SimChip *sim_chip_new_bus(SimChipType type, size_t width);
+
+/*
+ * @return true for the gates that can have any number of inputs
+ */
+bool sim_chip_is_wide_gate(SimChip *chip);
+
+/*
+ * @return true for the chips that keep a state (flip-flops, latches and registers)
+ */
+bool sim_chip_is_sequential(SimChip *chip);
+
 /*
  * Frees the chip and its fields. It doesn't remove the connections between pins.
  */
@@ -102,19 +215,28 @@ bool sim_chip_toggle_output_pin(SimChip *chip, size_t index);
 
 /*
  * Adds "target" pin to "src" pin. "src" pin should be an output pin.
+ * A bus can only be connected to a bus of the same width.
  *
- * @return false when "src" is an input pin
+ * @return false when "src" is an input pin or the widths are different
  * */
 bool sim_pin_add_connection(SimPin *src, SimPin *target);
 
 
 /*
- * Removes "target" pin from "src" pin
+ * Removes "target" pin from "src" pin, "target" is left floating (PIN_Z)
  *
  * @return true if pin is found and removed
  * */
 bool sim_pin_remove_connection(SimPin *src, SimPin *target);
 
+/*
+ * @return true if the pin is PIN_HIGH, for a bus if any bit is HIGH
+ */
 bool sim_pin_is_high(SimPin *pin);
 
+/*
+ * @return true if the pin is PIN_X or PIN_Z, for a bus if any bit is unknown
+ */
+bool sim_pin_is_unknown(SimPin *pin);
+
 #endif // SIMULATION_H
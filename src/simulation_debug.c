@@ -14,32 +14,60 @@ static void print_pin_array(SimPinArray pinArr, bool isInput) {
     printf("  "ASCII_YELLOW"%s Pins"ASCII_RESET"\n", type);
     for(size_t i = 0; i < pinArr.count; i++) {
         SimPin pin = pinArr.items[i];
-        const char *state = pin.state == PIN_HIGH
-            ? ASCII_BOLD_GREEN"ON"ASCII_RESET
-            : ASCII_BOLD_RED"OFF"ASCII_RESET;
+        if(pin.width > 1) {
+            printf("    "ASCII_CYAN"#%lu"ASCII_RESET" is a bus of %zu bits, "ASCII_BOLD_GREEN"ON"ASCII_RESET" 0x%llx "ASCII_BOLD_RED"OFF"ASCII_RESET" 0x%llx\n",
+                i, pin.width, (unsigned long long)pin.bits.high, (unsigned long long)pin.bits.low);
+            continue;
+        }
+
+        const char *state;
+        switch(pin.state) {
+            case PIN_LOW:
+                state = ASCII_BOLD_RED"OFF"ASCII_RESET;
+                break;
+            case PIN_HIGH:
+                state = ASCII_BOLD_GREEN"ON"ASCII_RESET;
+                break;
+            case PIN_Z:
+                state = ASCII_YELLOW"Z"ASCII_RESET;
+                break;
+            case PIN_X:
+                state = ASCII_YELLOW"X"ASCII_RESET;
+                break;
+        }
         printf("    "ASCII_CYAN"#%lu"ASCII_RESET" is %s\n", i, state);
     }
 }
 
-void sim_debug_print(Simulation sim) {
-    if(sim.chips->count == 0) return;
+const char *sim_debug_chip_name(SimChipType type) {
+    switch(type) {
+        case SIM_CHIP_INPUT: return "INPUT";
+        case SIM_CHIP_NAND: return "NAND";
+        case SIM_CHIP_OUTPUT: return "OUTPUT";
+        case SIM_CHIP_CLOCK: return "CLOCK";
+        case SIM_CHIP_DFF: return "DFF";
+        case SIM_CHIP_SR_LATCH: return "SR LATCH";
+        case SIM_CHIP_REGISTER: return "REGISTER";
+        case SIM_CHIP_AND: return "AND";
+        case SIM_CHIP_OR: return "OR";
+        case SIM_CHIP_XOR: return "XOR";
+        case SIM_CHIP_NOR: return "NOR";
+        case SIM_CHIP_XNOR: return "XNOR";
+        case SIM_CHIP_NOT: return "NOT";
+        case SIM_CHIP_BUF: return "BUF";
+        case SIM_CHIP_SPLITTER: return "SPLITTER";
+        case SIM_CHIP_MERGER: return "MERGER";
+    }
+    return "UNKNOWN";
+}
+
+void sim_debug_print(SimContext *context) {
+    if(context->chips->count == 0) return;
     printf("\n");
-    SetItem *chipItem = sim.chips->head;
+    SetItem *chipItem = context->chips->head;
     while(chipItem != NULL) {
         SimChip *chip = chipItem->data;
-        char *chipName;
-        switch(chip->type) {
-            case SIM_CHIP_INPUT:
-                chipName = "INPUT";
-                break;
-            case SIM_CHIP_NAND:
-                chipName = "NAND";
-                break;
-            case SIM_CHIP_OUTPUT:
-                chipName = "OUTPUT";
-                break;
-        }
-
+        const char *chipName = sim_debug_chip_name(chip->type);
         printf(ASCII_BOLD_BLUE"%s"ASCII_RESET"\n", chipName);
         print_pin_array(chip->inputs, true);
         print_pin_array(chip->outputs, false);
@@ -48,3 +76,40 @@ void sim_debug_print(Simulation sim) {
     }
     printf("\n");
 }
+
+void sim_debug_print_netlist(SimNetlist *netlist) {
+    size_t nandCount = 0;
+    size_t lutCount = 0;
+    size_t lutInputs = 0;
+    size_t wideCount = 0;
+    size_t wideInputs = 0;
+    for(size_t i = 0; i < netlist->gates.count; i++) {
+        SimNetGate gate = netlist->gates.items[i];
+        switch(gate.type) {
+            case SIM_NET_GATE_NAND:
+                nandCount++;
+                break;
+            case SIM_NET_GATE_LUT:
+                lutCount++;
+                lutInputs += gate.inputCount;
+                break;
+            default:
+                wideCount++;
+                wideInputs += gate.inputCount;
+                break;
+        }
+    }
+
+    printf("\n"ASCII_BOLD_BLUE"NETLIST"ASCII_RESET"\n");
+    printf("  "ASCII_YELLOW"Nets"ASCII_RESET" %lu\n", netlist->netCount);
+    printf("  "ASCII_YELLOW"Gates"ASCII_RESET" %lu%s\n", netlist->gates.count, netlist->hasFeedback ? " (with feedback)" : "");
+    printf("    "ASCII_CYAN"NAND"ASCII_RESET" %lu\n", nandCount);
+    printf("    "ASCII_CYAN"LUT"ASCII_RESET" %lu", lutCount);
+    if(lutCount > 0) printf(" (%.1f inputs on average)", (double)lutInputs / lutCount);
+    printf("\n");
+    printf("    "ASCII_CYAN"Wide"ASCII_RESET" %lu", wideCount);
+    if(wideCount > 0) printf(" (%.1f inputs on average)", (double)wideInputs / wideCount);
+    printf("\n");
+    printf("  "ASCII_YELLOW"Sequential"ASCII_RESET" %lu\n", netlist->sequential.count);
+    printf("\n");
+}
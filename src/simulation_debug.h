@@ -2,7 +2,15 @@
 #define SIMULATION_DEBUG_H
 
 #include "simulation.h"
+#include "simulation_netlist.h"
 
-void sim_debug_print(Simulation sim);
+const char *sim_debug_chip_name(SimChipType type);
+
+void sim_debug_print(SimContext *context);
+
+/*
+ * Prints how many nets and gates of each type the netlist has.
+ */
+void sim_debug_print_netlist(SimNetlist *netlist);
 
 #endif // SIMULATION_DEBUG_H
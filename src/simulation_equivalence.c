@@ -0,0 +1,199 @@
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "simulation_equivalence.h"
+#include "simulation_stimulus.h"
+
+typedef struct {
+    SimEquivalenceOptions options;
+    size_t inputCount;
+    size_t outputCount;
+    size_t wordCount;
+
+    // the workers take the words in order until there are none left
+    atomic_size_t nextWord;
+    // the lowest word with a mismatch, "wordCount" while there's none
+    atomic_size_t firstMismatch;
+} Equivalence;
+
+// a netlist for each circuit
+typedef struct {
+    SimNetlist *netlists[2];
+    SimNetlistState initial[2];
+    // with a state a vector could depend on the previous ones, so every word starts from the beginning
+    bool stateful;
+} EquivalencePair;
+
+typedef struct {
+    Equivalence *equivalence;
+    SimContext *clones[2];
+    pthread_t thread;
+} EquivalenceWorker;
+
+// splitmix64, the value of an input only depends on the seed, the word and the input
+static uint64_t random_word(size_t seed, size_t word, size_t input) {
+    uint64_t x = seed + (word*0x100000001B3llu + input + 1)*0x9E3779B97F4A7C15llu;
+    x = (x ^ (x >> 30))*0xBF58476D1CE4E5B9llu;
+    x = (x ^ (x >> 27))*0x94D049BB133111EBllu;
+    return x ^ (x >> 31);
+}
+
+static void pair_compile(Equivalence *equivalence, SimContext *contexts[2], EquivalencePair *pair) {
+    pair->stateful = false;
+    for(size_t i = 0; i < 2; i++) {
+        SimNetlist *netlist = sim_netlist_compile(contexts[i]->chips, equivalence->options.netlists[i]);
+        assert(netlist->inputs.count == equivalence->inputCount && netlist->outputs.count == equivalence->outputCount);
+        netlist->lanes = 64;
+        pair->netlists[i] = netlist;
+        pair->initial[i] = sim_netlist_save_state(netlist);
+        pair->stateful |= netlist->hasFeedback || netlist->sequential.count > 0;
+    }
+}
+
+static void pair_free(EquivalencePair *pair) {
+    for(size_t i = 0; i < 2; i++) {
+        sim_netlist_state_free(&pair->initial[i]);
+        sim_netlist_free(pair->netlists[i]);
+    }
+}
+
+// @return the lanes where any output is different, "outputs" gets them for each output when it's not NULL
+static uint64_t run_word(Equivalence *equivalence, EquivalencePair *pair, size_t word, uint64_t *outputs) {
+    for(size_t i = 0; i < 2; i++) {
+        SimNetlist *netlist = pair->netlists[i];
+        if(pair->stateful) sim_netlist_load_state(netlist, &pair->initial[i]);
+        for(size_t input = 0; input < equivalence->inputCount; input++) {
+            sim_netlist_set_input(netlist, input, random_word(equivalence->options.seed, word, input));
+        }
+        sim_netlist_eval(netlist);
+        sim_netlist_run_cycles(netlist, equivalence->options.cyclesPerVector, NULL, NULL);
+    }
+
+    uint64_t different = 0;
+    for(size_t i = 0; i < equivalence->outputCount; i++) {
+        uint64_t values = sim_netlist_get_output(pair->netlists[0], i) ^ sim_netlist_get_output(pair->netlists[1], i);
+        uint64_t unknown = sim_netlist_get_output_unknown(pair->netlists[0], i) ^ sim_netlist_get_output_unknown(pair->netlists[1], i);
+        if(outputs != NULL) outputs[i] = values | unknown;
+        different |= values | unknown;
+    }
+    return different;
+}
+
+static void found_mismatch(Equivalence *equivalence, size_t word) {
+    size_t current = atomic_load(&equivalence->firstMismatch);
+    while(word < current && !atomic_compare_exchange_weak(&equivalence->firstMismatch, &current, word));
+}
+
+static void *equivalence_worker(void *data) {
+    EquivalenceWorker *worker = data;
+    Equivalence *equivalence = worker->equivalence;
+
+    EquivalencePair pair;
+    pair_compile(equivalence, worker->clones, &pair);
+
+    for(;;) {
+        size_t first = atomic_fetch_add(&equivalence->nextWord, SIM_EQUIVALENCE_BATCH_WORDS);
+        // the words after a mismatch don't matter, only the first one is reported
+        if(first >= atomic_load(&equivalence->firstMismatch)) break;
+
+        size_t last = first + SIM_EQUIVALENCE_BATCH_WORDS;
+        if(last > equivalence->wordCount) last = equivalence->wordCount;
+        for(size_t word = first; word < last; word++) {
+            if(run_word(equivalence, &pair, word, NULL) != 0) {
+                found_mismatch(equivalence, word);
+                break;
+            }
+        }
+    }
+
+    pair_free(&pair);
+    return NULL;
+}
+
+// runs the word again to find the first vector and output that are different
+static void describe_mismatch(Equivalence *equivalence, SimContext *contexts[2], size_t word, SimEquivalenceResult *result) {
+    EquivalencePair pair;
+    pair_compile(equivalence, contexts, &pair);
+
+    uint64_t *outputs = alloc((equivalence->outputCount + 1)*sizeof(uint64_t));
+    uint64_t different = run_word(equivalence, &pair, word, outputs);
+    assert(different != 0 && "The mismatch can't be reproduced");
+
+    size_t lane = 0;
+    while(!((different >> lane) & 1)) lane++;
+    result->vector = word*64 + lane;
+    for(size_t i = 0; i < equivalence->outputCount; i++) {
+        if((outputs[i] >> lane) & 1) {
+            result->output = i;
+            break;
+        }
+    }
+    for(size_t i = 0; i < 2; i++) {
+        result->values[i] = (sim_netlist_get_output(pair.netlists[i], result->output) >> lane) & 1;
+    }
+
+    result->inputs = alloc(equivalence->inputCount + 1);
+    for(size_t i = 0; i < equivalence->inputCount; i++) {
+        result->inputs[i] = (random_word(equivalence->options.seed, word, i) >> lane) & 1 ? '1' : '0';
+    }
+
+    free(outputs);
+    pair_free(&pair);
+}
+
+bool sim_equivalence_check(SimContext *contexts[2], SimEquivalenceOptions options, SimEquivalenceResult *result) {
+    *result = (SimEquivalenceResult){ .equivalent = true };
+
+    size_t inputCounts[2], outputCounts[2];
+    for(size_t i = 0; i < 2; i++) {
+        inputCounts[i] = sim_stimulus_count_chips(contexts[i], SIM_CHIP_INPUT);
+        outputCounts[i] = sim_stimulus_count_chips(contexts[i], SIM_CHIP_OUTPUT);
+    }
+    if(inputCounts[0] != inputCounts[1] || outputCounts[0] != outputCounts[1]) {
+        printf("[ERROR] Can't compare a circuit of %zu inputs and %zu outputs with one of %zu inputs and %zu outputs\n",
+            inputCounts[0], outputCounts[0], inputCounts[1], outputCounts[1]);
+        return false;
+    }
+
+    Equivalence equivalence = {
+        .options = options,
+        .inputCount = inputCounts[0],
+        .outputCount = outputCounts[0],
+        .wordCount = (options.vectors + 63) / 64,
+    };
+    atomic_init(&equivalence.nextWord, 0);
+    atomic_init(&equivalence.firstMismatch, equivalence.wordCount);
+
+    size_t batchCount = (equivalence.wordCount + SIM_EQUIVALENCE_BATCH_WORDS - 1) / SIM_EQUIVALENCE_BATCH_WORDS;
+    size_t threads = options.threads;
+    if(threads == 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if(threads > batchCount) threads = batchCount;
+
+    // the clones are made before any thread starts, so the contexts are only read here
+    EquivalenceWorker *workers = alloc((threads + 1)*sizeof(EquivalenceWorker));
+    for(size_t i = 0; i < threads; i++) {
+        workers[i].equivalence = &equivalence;
+        workers[i].clones[0] = sim_context_clone(contexts[0]);
+        workers[i].clones[1] = sim_context_clone(contexts[1]);
+        pthread_create(&workers[i].thread, NULL, equivalence_worker, &workers[i]);
+    }
+    for(size_t i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        sim_context_free_chips(workers[i].clones[0]);
+        sim_context_free_chips(workers[i].clones[1]);
+    }
+    free(workers);
+
+    size_t mismatch = atomic_load(&equivalence.firstMismatch);
+    if(mismatch < equivalence.wordCount) {
+        result->equivalent = false;
+        describe_mismatch(&equivalence, contexts, mismatch, result);
+    }
+    return true;
+}
+
+void sim_equivalence_result_free(SimEquivalenceResult *result) {
+    free(result->inputs);
+    result->inputs = NULL;
+}
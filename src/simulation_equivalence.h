@@ -0,0 +1,57 @@
+#ifndef SIMULATION_EQUIVALENCE_H
+#define SIMULATION_EQUIVALENCE_H
+
+#include "simulation.h"
+#include "simulation_netlist.h"
+
+/*
+ * Checks that two circuits behave the same by driving both with the same
+ * random vectors and comparing their outputs. The chips don't have names, so
+ * the inputs and outputs are matched by their order: the first SIM_CHIP_INPUT
+ * of a circuit with the first of the other one and so on.
+ *
+ * Every circuit is compiled with its own SimNetlistOptions, so a circuit can
+ * also be checked against itself to compare an optimized netlist with the
+ * original one. The vectors are split in words of 64, one per lane, between
+ * threads, each one with clones of both contexts.
+ *
+ * Every vector starts from the current state of the chips, settles and runs
+ * "cyclesPerVector" clock cycles before the outputs are compared. The vectors
+ * only depend on the seed, so a mismatch can be reproduced running the same
+ * check again.
+ */
+
+// words of vectors taken by a thread at a time
+#define SIM_EQUIVALENCE_BATCH_WORDS 64
+
+typedef struct {
+    // worker threads, 0 uses one for each processor
+    size_t threads;
+    // number of random vectors, rounded up to a multiple of 64
+    size_t vectors;
+    size_t seed;
+    // clock cycles run after applying each vector, before comparing the outputs
+    size_t cyclesPerVector;
+    SimNetlistOptions netlists[2];
+} SimEquivalenceOptions;
+
+typedef struct {
+    bool equivalent;
+    // only set when the circuits aren't equivalent
+    size_t vector;
+    size_t output;
+    // the value of the output in each circuit
+    bool values[2];
+    // '0' or '1' for each input of the first vector that is different, NULL when there's none
+    char *inputs;
+} SimEquivalenceResult;
+
+/*
+ * @return false when the circuits can't be compared because they don't have
+ * the same number of inputs or outputs
+ */
+bool sim_equivalence_check(SimContext *contexts[2], SimEquivalenceOptions options, SimEquivalenceResult *result);
+
+void sim_equivalence_result_free(SimEquivalenceResult *result);
+
+#endif // SIMULATION_EQUIVALENCE_H
@@ -0,0 +1,239 @@
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "simulation_fault.h"
+#include "simulation_netlist.h"
+#include "simulation_stimulus.h"
+#include "simulation_debug.h"
+
+typedef struct {
+    uint32_t net;
+    bool high;
+    // where the fault is, to write the report
+    size_t chipIndex;
+    SimChipType chipType;
+    size_t output;
+    size_t bit;
+    size_t width;
+} Fault;
+
+typedef struct {
+    Fault *items;
+    size_t count;
+    size_t capacity;
+} FaultArray;
+
+typedef struct {
+    SimStimulus *stimulus;
+    FaultArray faults;
+    SimFaultOptions options;
+
+    size_t groupCount;
+    // lanes detected by every set in every group, indexed by group*setCount + set,
+    // each group is only written by the worker that runs it
+    uint64_t *detected;
+    // the workers take the groups in order until there are none left
+    atomic_size_t nextGroup;
+} FaultSimulation;
+
+typedef struct {
+    FaultSimulation *simulation;
+    SimContext *clone;
+    pthread_t thread;
+} FaultWorker;
+
+static SimNetlist *compile_netlist(SimContext *context) {
+    // without optimizing every output pin keeps its own net
+    return sim_netlist_compile(context->chips, (SimNetlistOptions){
+        .backend = SIM_BACKEND_LEVELIZED,
+    });
+}
+
+// two faults for every bit of every output pin, in the order of the chips
+static void collect_faults(SimContext *context, FaultArray *faults) {
+    SimNetlist *netlist = compile_netlist(context);
+
+    Map *chipIndices = map_new();
+    size_t index = 0;
+    for(SetItem *item = context->chips->head; item != NULL; item = item->next) {
+        map_set(chipIndices, item->data, index++);
+    }
+
+    for(size_t i = 0; i < netlist->pins.count; i++) {
+        SimNetPin netPin = netlist->pins.items[i];
+        if(netPin.pin->isInput) continue;
+
+        SimChip *chip = netPin.pin->parentChip;
+        Fault fault = {
+            .net = netPin.net,
+            .chipType = chip->type,
+            .output = netPin.pin - chip->outputs.items,
+            .bit = netPin.bit,
+            .width = netPin.pin->width,
+        };
+        map_get(chipIndices, chip, &fault.chipIndex);
+
+        fault.high = false;
+        da_append(faults, fault);
+        fault.high = true;
+        da_append(faults, fault);
+    }
+
+    map_free(chipIndices);
+    sim_netlist_free(netlist);
+}
+
+// @return the faulty lanes where an output is different from lane 0
+static uint64_t compare_outputs(SimNetlist *netlist, uint64_t lanes) {
+    uint64_t different = 0;
+    for(size_t i = 0; i < netlist->outputs.count; i++) {
+        uint64_t value = sim_netlist_get_output(netlist, i);
+        uint64_t good = (value & 1) ? ~0llu : 0;
+        different |= value ^ good;
+    }
+    return different & lanes;
+}
+
+static uint64_t run_set(FaultSimulation *simulation, SimNetlist *netlist, SimStimulusSet *set, uint64_t lanes) {
+    uint64_t detected = 0;
+    for(size_t step = 0; step < set->count; step++) {
+        char *vector = simulation->stimulus->vectors[set->first + step];
+        for(size_t i = 0; i < simulation->stimulus->inputCount; i++) {
+            sim_netlist_set_input(netlist, i, vector[i] == '1' ? ~0llu : 0);
+        }
+
+        sim_netlist_eval(netlist);
+        sim_netlist_run_cycles(netlist, simulation->options.cyclesPerVector, NULL, NULL);
+
+        detected |= compare_outputs(netlist, lanes);
+        // nothing else to find in this set
+        if(detected == lanes) break;
+    }
+    return detected;
+}
+
+static void *fault_worker(void *data) {
+    FaultWorker *worker = data;
+    FaultSimulation *simulation = worker->simulation;
+
+    SimNetlist *netlist = compile_netlist(worker->clone);
+    assert(netlist->inputs.count == simulation->stimulus->inputCount);
+
+    // every set starts from the state the netlist has after compiling
+    SimNetlistState initial = sim_netlist_save_state(netlist);
+
+    size_t setCount = simulation->stimulus->setCount;
+    for(;;) {
+        size_t group = atomic_fetch_add(&simulation->nextGroup, 1);
+        if(group >= simulation->groupCount) break;
+
+        Fault *faults = &simulation->faults.items[group*SIM_FAULT_GROUP_SIZE];
+        size_t faultCount = simulation->faults.count - group*SIM_FAULT_GROUP_SIZE;
+        if(faultCount > SIM_FAULT_GROUP_SIZE) faultCount = SIM_FAULT_GROUP_SIZE;
+        netlist->lanes = faultCount + 1;
+        uint64_t lanes = ((~0llu) >> (64 - netlist->lanes)) & ~1llu;
+
+        for(size_t set = 0; set < setCount; set++) {
+            sim_netlist_clear_faults(netlist);
+            sim_netlist_load_state(netlist, &initial);
+            for(size_t i = 0; i < faultCount; i++) {
+                sim_netlist_inject_fault(netlist, faults[i].net, 1llu << (i + 1), faults[i].high);
+            }
+
+            uint64_t detected = run_set(simulation, netlist, &simulation->stimulus->sets[set], lanes);
+            simulation->detected[group*setCount + set] = detected;
+        }
+    }
+
+    sim_netlist_state_free(&initial);
+    sim_netlist_free(netlist);
+    return NULL;
+}
+
+static bool is_detected(FaultSimulation *simulation, size_t fault, size_t set) {
+    size_t group = fault / SIM_FAULT_GROUP_SIZE;
+    size_t lane = fault % SIM_FAULT_GROUP_SIZE + 1;
+    return (simulation->detected[group*simulation->stimulus->setCount + set] >> lane) & 1;
+}
+
+static bool write_report(FaultSimulation *simulation, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if(file == NULL) {
+        printf("[ERROR] Couldn't open %s\n", path);
+        return false;
+    }
+
+    fprintf(file, "# id chip type output fault\n");
+    for(size_t i = 0; i < simulation->faults.count; i++) {
+        Fault *fault = &simulation->faults.items[i];
+        fprintf(file, "%zu %zu %s %zu", i, fault->chipIndex, sim_debug_chip_name(fault->chipType), fault->output);
+        if(fault->width > 1) fprintf(file, ".%zu", fault->bit);
+        fprintf(file, " %s\n", fault->high ? "SA1" : "SA0");
+    }
+
+    bool *detected = alloc((simulation->faults.count + 1)*sizeof(bool));
+    size_t detectedCount = 0;
+    for(size_t set = 0; set < simulation->stimulus->setCount; set++) {
+        fprintf(file, "set %zu:", set);
+        for(size_t i = 0; i < simulation->faults.count; i++) {
+            if(!is_detected(simulation, i, set)) continue;
+            fprintf(file, " %zu", i);
+            if(!detected[i]) detectedCount++;
+            detected[i] = true;
+        }
+        fputc('\n', file);
+    }
+
+    double coverage = simulation->faults.count > 0 ? 100.0*detectedCount/simulation->faults.count : 100.0;
+    fprintf(file, "detected %zu of %zu faults (%.2f%%)\n", detectedCount, simulation->faults.count, coverage);
+    fprintf(file, "undetected:");
+    for(size_t i = 0; i < simulation->faults.count; i++) {
+        if(!detected[i]) fprintf(file, " %zu", i);
+    }
+    fputc('\n', file);
+
+    free(detected);
+    fclose(file);
+    return true;
+}
+
+bool sim_fault_run(SimContext *context, const char *stimulusPath, const char *reportPath, SimFaultOptions options) {
+    SimStimulus *stimulus = sim_stimulus_load(stimulusPath, sim_stimulus_count_chips(context, SIM_CHIP_INPUT));
+    if(stimulus == NULL) return false;
+
+    FaultSimulation simulation = {
+        .stimulus = stimulus,
+        .options = options,
+    };
+    collect_faults(context, &simulation.faults);
+
+    simulation.groupCount = (simulation.faults.count + SIM_FAULT_GROUP_SIZE - 1) / SIM_FAULT_GROUP_SIZE;
+    simulation.detected = alloc((simulation.groupCount*stimulus->setCount + 1)*sizeof(uint64_t));
+    atomic_init(&simulation.nextGroup, 0);
+
+    size_t threads = options.threads;
+    if(threads == 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if(threads > simulation.groupCount) threads = simulation.groupCount;
+    if(stimulus->setCount == 0) threads = 0;
+
+    // the clones are made before any thread starts, so the context is only read here
+    FaultWorker *workers = alloc((threads + 1)*sizeof(FaultWorker));
+    for(size_t i = 0; i < threads; i++) {
+        workers[i].simulation = &simulation;
+        workers[i].clone = sim_context_clone(context);
+        pthread_create(&workers[i].thread, NULL, fault_worker, &workers[i]);
+    }
+    for(size_t i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        sim_context_free_chips(workers[i].clone);
+    }
+    free(workers);
+
+    bool ok = write_report(&simulation, reportPath);
+    free(simulation.detected);
+    da_free(&simulation.faults);
+    sim_stimulus_free(stimulus);
+    return ok;
+}
@@ -0,0 +1,48 @@
+#ifndef SIMULATION_FAULT_H
+#define SIMULATION_FAULT_H
+
+#include "simulation.h"
+
+/*
+ * Grades a stimulus file (see simulation_stimulus.h) with stuck-at faults.
+ *
+ * Every output pin of the circuit (every bit of a bus) gets two faults, stuck
+ * at LOW and stuck at HIGH. A set of the stimulus detects a fault when, after
+ * any of its vectors, an output chip has a different value than in the circuit
+ * without faults. The vectors are applied like in sim_sweep_run: the circuit
+ * settles and runs "cyclesPerVector" clock cycles before reading the outputs.
+ *
+ * The circuit is compiled to a two-state netlist where lane 0 is the good
+ * circuit and the other SIM_FAULT_GROUP_SIZE lanes have one fault each, so a
+ * pass over the gates simulates 63 faulty circuits at once. The groups are
+ * split between threads, each one with its own clone of the context.
+ *
+ * The report lists the faults with an id, which chip and output they're on,
+ * the faults detected by each set and the coverage of the whole stimulus:
+ *
+ *   # id chip type output fault
+ *   0 4 NAND 0 SA0
+ *   1 4 NAND 0 SA1
+ *   ...
+ *   set 0: 0 1 5
+ *   set 1: 2
+ *   detected 4 of 10 faults (40.00%)
+ *   undetected: 3 4 6 7 8 9
+ */
+
+// lanes with a fault in each word, the first lane is the circuit without faults
+#define SIM_FAULT_GROUP_SIZE 63
+
+typedef struct {
+    // worker threads, 0 uses one for each processor
+    size_t threads;
+    // clock cycles run after applying each vector, before reading the outputs
+    size_t cyclesPerVector;
+} SimFaultOptions;
+
+/*
+ * @return false when a file can't be opened or the stimulus is invalid
+ */
+bool sim_fault_run(SimContext *context, const char *stimulusPath, const char *reportPath, SimFaultOptions options);
+
+#endif // SIMULATION_FAULT_H
@@ -0,0 +1,62 @@
+#ifndef SIMULATION_LOGIC_H
+#define SIMULATION_LOGIC_H
+
+#include <stdint.h>
+
+/*
+ * Four-state logic stored in two bit-planes, every bit is an independent lane:
+ *
+ *   high low
+ *     0    1   LOW
+ *     1    0   HIGH
+ *     0    0   X (unknown)
+ *
+ * Z (high impedance) is read by the gates as X and a gate never outputs it,
+ * so it doesn't need its own encoding here. With this encoding the NAND is
+ * only two bitwise operations, same as in two-state logic, and inverting a
+ * value is just swapping the planes.
+ */
+typedef struct {
+    uint64_t high;
+    uint64_t low;
+} SimLogic;
+
+static inline SimLogic sim_logic_not(SimLogic a) {
+    return (SimLogic){ .high = a.low, .low = a.high };
+}
+
+static inline SimLogic sim_logic_and(SimLogic a, SimLogic b) {
+    return (SimLogic){
+        .high = a.high & b.high,
+        .low = a.low | b.low,
+    };
+}
+
+static inline SimLogic sim_logic_or(SimLogic a, SimLogic b) {
+    return (SimLogic){
+        .high = a.high | b.high,
+        .low = a.low & b.low,
+    };
+}
+
+static inline SimLogic sim_logic_xor(SimLogic a, SimLogic b) {
+    // an unknown input leaves both planes empty
+    return (SimLogic){
+        .high = (a.high & b.low) | (a.low & b.high),
+        .low = (a.high & b.high) | (a.low & b.low),
+    };
+}
+
+static inline SimLogic sim_logic_nand(SimLogic a, SimLogic b) {
+    return (SimLogic){
+        // a single low input is enough to know the output
+        .high = a.low | b.low,
+        .low = a.high & b.high,
+    };
+}
+
+static inline uint64_t sim_logic_unknown(SimLogic logic) {
+    return ~(logic.high | logic.low);
+}
+
+#endif // SIMULATION_LOGIC_H
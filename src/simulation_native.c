@@ -0,0 +1,349 @@
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+
+#include "simulation_native.h"
+
+// the generated code is split in functions of this size, so the compiler doesn't
+// spend ages optimizing a single huge function
+#define NATIVE_GATES_PER_FUNCTION 256
+
+static const char *nativeHeader =
+    "#include <stdint.h>\n"
+    "#include <stddef.h>\n"
+    "\n";
+
+// the program of a LUT gate is a tree, every result is read by a single operation,
+// so it's written as a single expression starting from the last operation
+static void emit_lut_operand(FILE *file, SimNetGate *gate, size_t operand) {
+    if(operand < gate->inputCount) {
+        fprintf(file, "v[%u]", gate->inputs[operand]);
+        return;
+    }
+
+    SimLutOp op = gate->program[operand - gate->inputCount];
+    switch(op.type) {
+        case SIM_LUT_OP_ZERO: fprintf(file, "0ull"); return;
+        case SIM_LUT_OP_ONE: fprintf(file, "~0ull"); return;
+        case SIM_LUT_OP_COPY: emit_lut_operand(file, gate, op.a); return;
+        case SIM_LUT_OP_NOT: fprintf(file, "~"); emit_lut_operand(file, gate, op.a); return;
+        case SIM_LUT_OP_MUX:
+            // the select is always an input, so it's the one written twice
+            fprintf(file, "((");
+            emit_lut_operand(file, gate, op.b);
+            fprintf(file, " & ~");
+            emit_lut_operand(file, gate, op.a);
+            fprintf(file, ") | (");
+            emit_lut_operand(file, gate, op.c);
+            fprintf(file, " & ");
+            emit_lut_operand(file, gate, op.a);
+            fprintf(file, "))");
+            return;
+        default: break;
+    }
+
+    const char *operators[] = {
+        [SIM_LUT_OP_AND] = " & ",
+        [SIM_LUT_OP_OR] = " | ",
+        [SIM_LUT_OP_XOR] = " ^ ",
+        [SIM_LUT_OP_AND_NOT] = " & ~",
+        [SIM_LUT_OP_OR_NOT] = " | ~",
+    };
+    fprintf(file, "(");
+    emit_lut_operand(file, gate, op.a);
+    fputs(operators[op.type], file);
+    emit_lut_operand(file, gate, op.b);
+    fprintf(file, ")");
+}
+
+// writes the inputs of the gate from the plane "plane" joined with "operator"
+static void emit_reduction(FILE *file, SimNetGate *gate, const char *plane, const char *operator) {
+    for(size_t i = 0; i < gate->inputCount; i++) {
+        fprintf(file, "%s%s[%u]", i == 0 ? "" : operator, plane, gate->inputs[i]);
+    }
+}
+
+static const char *get_reduction_operator(SimNetGateType type) {
+    switch(type) {
+        case SIM_NET_GATE_AND: return " & ";
+        case SIM_NET_GATE_OR:
+        case SIM_NET_GATE_NOR: return " | ";
+        case SIM_NET_GATE_XOR:
+        case SIM_NET_GATE_XNOR: return " ^ ";
+        default: panic("Not a wide gate");
+    }
+    return NULL;
+}
+
+static void emit_gate_expr(FILE *file, SimNetGate *gate) {
+    switch(gate->type) {
+        case SIM_NET_GATE_NAND:
+            fprintf(file, "~(v[%u] & v[%u])", gate->inputs[0], gate->inputs[1]);
+            break;
+        case SIM_NET_GATE_LUT:
+            emit_lut_operand(file, gate, gate->inputCount + gate->programCount - 1);
+            break;
+        default:
+            fprintf(file, sim_net_gate_is_inverted(gate->type) ? "~(" : "(");
+            emit_reduction(file, gate, "v", get_reduction_operator(gate->type));
+            fprintf(file, ")");
+            break;
+    }
+}
+
+// with four-state logic most nets usually can't be X, like a gate that only reads inputs.
+// The generated code only writes their value plane, their low plane is the inverse of it
+typedef enum {
+    NATIVE_NET_UNKNOWN,
+    NATIVE_NET_KNOWN,
+    // can't be X but the sequential chips or the outputs read its low plane, so it's written anyway
+    NATIVE_NET_KNOWN_READ,
+} NativeNet;
+
+static NativeNet *get_native_nets(SimNetlist *netlist) {
+    NativeNet *nets = alloc(netlist->netCount*sizeof(NativeNet));
+    nets[SIM_NET_LOW] = NATIVE_NET_KNOWN;
+    nets[SIM_NET_HIGH] = NATIVE_NET_KNOWN;
+    for(size_t i = 0; i < netlist->inputs.count; i++) {
+        nets[netlist->inputs.items[i].net] = NATIVE_NET_KNOWN;
+    }
+    for(size_t i = 0; i < netlist->clocks.count; i++) {
+        nets[netlist->clocks.items[i].net] = NATIVE_NET_KNOWN;
+    }
+
+    // the gates are levelized, so their inputs are checked before them
+    for(size_t i = 0; i < netlist->gates.count; i++) {
+        SimNetGate *gate = &netlist->gates.items[i];
+        if(gate->feedback) continue;
+        bool known = true;
+        for(size_t j = 0; j < gate->inputCount; j++) {
+            known &= nets[gate->inputs[j]] != NATIVE_NET_UNKNOWN;
+        }
+        if(known) nets[gate->output] = NATIVE_NET_KNOWN;
+    }
+
+    for(size_t i = 0; i < netlist->sequential.count; i++) {
+        SimNetSequential *sequential = &netlist->sequential.items[i];
+        for(size_t j = 0; j < sequential->inputCount; j++) {
+            if(nets[sequential->inputs[j]] == NATIVE_NET_KNOWN) nets[sequential->inputs[j]] = NATIVE_NET_KNOWN_READ;
+        }
+    }
+    for(size_t i = 0; i < netlist->outputs.count; i++) {
+        uint32_t net = netlist->outputs.items[i].net;
+        if(nets[net] == NATIVE_NET_KNOWN) nets[net] = NATIVE_NET_KNOWN_READ;
+    }
+    return nets;
+}
+
+// the low plane of a net that can't be X isn't loaded, it's the inverse of its value
+static void emit_low(FILE *file, NativeNet *nets, uint32_t net) {
+    if(nets[net] != NATIVE_NET_UNKNOWN) {
+        fprintf(file, "~v[%u]", net);
+    } else {
+        fprintf(file, "l[%u]", net);
+    }
+}
+
+// like emit_reduction for the low plane
+static void emit_low_reduction(FILE *file, SimNetGate *gate, NativeNet *nets, const char *operator) {
+    for(size_t i = 0; i < gate->inputCount; i++) {
+        if(i > 0) fputs(operator, file);
+        emit_low(file, nets, gate->inputs[i]);
+    }
+}
+
+// AND and OR are a reduction of each plane, XOR has to go one input at a time
+static void emit_wide_gate_four_state(FILE *file, SimNetGate *gate, NativeNet *nets) {
+    switch(gate->type) {
+        case SIM_NET_GATE_AND:
+            fprintf(file, "    h = ");
+            emit_reduction(file, gate, "v", " & ");
+            fprintf(file, "; l0 = ");
+            emit_low_reduction(file, gate, nets, " | ");
+            fprintf(file, ";");
+            break;
+        case SIM_NET_GATE_OR:
+        case SIM_NET_GATE_NOR:
+            fprintf(file, "    h = ");
+            emit_reduction(file, gate, "v", " | ");
+            fprintf(file, "; l0 = ");
+            emit_low_reduction(file, gate, nets, " & ");
+            fprintf(file, ";");
+            break;
+        case SIM_NET_GATE_XOR:
+        case SIM_NET_GATE_XNOR:
+            fprintf(file, "    h = v[%u]; l0 = ", gate->inputs[0]);
+            emit_low(file, nets, gate->inputs[0]);
+            fprintf(file, ";");
+            for(size_t i = 1; i < gate->inputCount; i++) {
+                uint32_t input = gate->inputs[i];
+                fprintf(file, " t = h; h = (t & ");
+                emit_low(file, nets, input);
+                fprintf(file, ") | (l0 & v[%u]); l0 = (t & v[%u]) | (l0 & ", input, input);
+                emit_low(file, nets, input);
+                fprintf(file, ");");
+            }
+            break;
+        default: break;
+    }
+
+    // inverting is swapping the planes
+    if(sim_net_gate_is_inverted(gate->type)) {
+        fprintf(file, " t = h; h = l0; l0 = t;");
+    }
+}
+
+// with four-state logic the result goes to "h" and "l" and then to both planes
+static void emit_gate_four_state(FILE *file, SimNetGate *gate, NativeNet *nets) {
+    assert(gate->type != SIM_NET_GATE_LUT && "The LUT gates don't support four-state logic");
+
+    if(gate->type == SIM_NET_GATE_NAND) {
+        fprintf(file, "    h = ");
+        emit_low(file, nets, gate->inputs[0]);
+        fprintf(file, " | ");
+        emit_low(file, nets, gate->inputs[1]);
+        fprintf(file, "; l0 = v[%u] & v[%u];", gate->inputs[0], gate->inputs[1]);
+    } else {
+        emit_wide_gate_four_state(file, gate, nets);
+    }
+
+    if(gate->feedback) {
+        fprintf(file, " c |= (h ^ v[%u]) | (l0 ^ l[%u]);", gate->output, gate->output);
+    }
+    fprintf(file, " v[%u] = h; l[%u] = l0;\n", gate->output, gate->output);
+}
+
+static void emit_gate(FILE *file, SimNetlist *netlist, SimNetGate *gate, NativeNet *nets) {
+    if(netlist->fourState && nets[gate->output] == NATIVE_NET_UNKNOWN) {
+        emit_gate_four_state(file, gate, nets);
+    } else if(netlist->fourState && nets[gate->output] == NATIVE_NET_KNOWN_READ) {
+        fprintf(file, "    v[%u] = ", gate->output);
+        emit_gate_expr(file, gate);
+        fprintf(file, "; l[%u] = ~v[%u];\n", gate->output, gate->output);
+    } else if(gate->feedback) {
+        // only the gates of a loop can change on a second pass
+        fprintf(file, "    t = ");
+        emit_gate_expr(file, gate);
+        fprintf(file, "; c |= t ^ v[%u]; v[%u] = t;\n", gate->output, gate->output);
+    } else {
+        fprintf(file, "    v[%u] = ", gate->output);
+        emit_gate_expr(file, gate);
+        fprintf(file, ";\n");
+    }
+}
+
+// sim_sync_lows writes the low plane of the gates that sim_step skips
+static void emit_sync_lows(FILE *file, SimNetlist *netlist, NativeNet *nets) {
+    size_t functionCount = 0;
+    size_t count = 0;
+    for(size_t i = 0; nets != NULL && i < netlist->gates.count; i++) {
+        uint32_t output = netlist->gates.items[i].output;
+        if(nets[output] != NATIVE_NET_KNOWN) continue;
+        if(count++ % NATIVE_GATES_PER_FUNCTION == 0) {
+            if(functionCount > 0) fprintf(file, "}\n\n");
+            fprintf(file, "__attribute__((noinline)) static void sync%zu(const uint64_t *v, uint64_t *l) {\n", functionCount++);
+        }
+        fprintf(file, "    l[%u] = ~v[%u];\n", output, output);
+    }
+    if(functionCount > 0) fprintf(file, "}\n\n");
+
+    fprintf(file, "void sim_sync_lows(const uint64_t *v, uint64_t *l) {\n");
+    for(size_t i = 0; i < functionCount; i++) {
+        fprintf(file, "    sync%zu(v, l);\n", i);
+    }
+    fprintf(file, "}\n\n");
+}
+
+static void emit_netlist(FILE *file, SimNetlist *netlist) {
+    fputs(nativeHeader, file);
+    NativeNet *nets = netlist->fourState ? get_native_nets(netlist) : NULL;
+
+    size_t functionCount = 0;
+    for(size_t i = 0; i < netlist->gates.count; i++) {
+        if(i % NATIVE_GATES_PER_FUNCTION == 0) {
+            if(i > 0) fprintf(file, "    return c;\n}\n\n");
+            fprintf(file, "__attribute__((noinline)) static uint64_t part%zu(uint64_t *v, uint64_t *l) {\n", functionCount++);
+            fprintf(file, "    uint64_t c = 0, t, h, l0;\n");
+        }
+        emit_gate(file, netlist, &netlist->gates.items[i], nets);
+    }
+    if(functionCount > 0) fprintf(file, "    return c;\n}\n\n");
+    emit_sync_lows(file, netlist, nets);
+
+    // the code is the same for any number of lanes
+    fprintf(file, "uint64_t sim_step(uint64_t *v, uint64_t *l, size_t lanes) {\n");
+    fprintf(file, "    uint64_t c = 0;\n");
+    for(size_t i = 0; i < functionCount; i++) {
+        fprintf(file, "    c |= part%zu(v, l);\n", i);
+    }
+    fprintf(file, "    return c;\n}\n");
+    free(nets);
+}
+
+SimNative *sim_native_compile(SimNetlist *netlist) {
+    char dir[] = "/tmp/logic-sim-XXXXXX";
+    if(mkdtemp(dir) == NULL) {
+        printf("[ERROR] Couldn't create a temporary directory for the native code\n");
+        return NULL;
+    }
+
+    char sourcePath[sizeof(dir) + 16];
+    char libraryPath[sizeof(dir) + 16];
+    snprintf(sourcePath, sizeof(sourcePath), "%s/netlist.c", dir);
+    snprintf(libraryPath, sizeof(libraryPath), "%s/netlist.so", dir);
+
+    SimNative *native = NULL;
+
+    FILE *file = fopen(sourcePath, "w");
+    if(file == NULL) {
+        printf("[ERROR] Couldn't write the native code to %s\n", sourcePath);
+        goto cleanup;
+    }
+    emit_netlist(file, netlist);
+    fclose(file);
+
+    const char *cc = getenv("CC");
+    if(cc == NULL) cc = SIM_NATIVE_DEFAULT_CC;
+
+    // every generated function has the same parameters and temporaries even when it
+    // doesn't use them, the rest of the warnings are still shown
+    char command[512];
+    int length = snprintf(command, sizeof(command), "%s -O1 -shared -fPIC -Wno-unused-parameter -Wno-unused-variable -o %s %s",
+        cc, libraryPath, sourcePath);
+    if(length < 0 || (size_t)length >= sizeof(command)) {
+        printf("[ERROR] The command to compile the native code is too long, check the CC variable\n");
+        goto cleanup;
+    }
+    if(system(command) != 0) {
+        printf("[ERROR] Couldn't compile the native code: %s\n", command);
+        goto cleanup;
+    }
+
+    void *handle = dlopen(libraryPath, RTLD_NOW | RTLD_LOCAL);
+    if(handle == NULL) {
+        printf("[ERROR] Couldn't load the native code: %s\n", dlerror());
+        goto cleanup;
+    }
+
+    native = alloc(sizeof(SimNative));
+    native->handle = handle;
+    native->step = (SimNativeStep)dlsym(handle, "sim_step");
+    native->syncLows = (SimNativeSyncLows)dlsym(handle, "sim_sync_lows");
+    if(native->step == NULL || native->syncLows == NULL) {
+        printf("[ERROR] The native code doesn't have the sim_step and sim_sync_lows functions\n");
+        sim_native_free(native);
+        native = NULL;
+    }
+
+cleanup:
+    // once the library is loaded the files aren't needed anymore
+    unlink(sourcePath);
+    unlink(libraryPath);
+    rmdir(dir);
+    return native;
+}
+
+void sim_native_free(SimNative *native) {
+    dlclose(native->handle);
+    free(native);
+}
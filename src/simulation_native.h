@@ -0,0 +1,39 @@
+#ifndef SIMULATION_NATIVE_H
+#define SIMULATION_NATIVE_H
+
+#include "simulation_netlist.h"
+
+// compiler used for the generated code, can be changed with the CC environment variable
+#define SIM_NATIVE_DEFAULT_CC "cc"
+
+/*
+ * Evaluates the whole netlist once and returns a non zero value if any
+ * net of a feedback loop changed.
+ */
+typedef uint64_t (*SimNativeStep)(uint64_t *values, uint64_t *lows, size_t lanes);
+
+/*
+ * With four-state logic the step only writes the value plane of the nets that can
+ * never be X (like a gate that only reads inputs), unless a sequential chip or an
+ * output reads them. This writes the low plane of the rest, the inverse of the value.
+ */
+typedef void (*SimNativeSyncLows)(const uint64_t *values, uint64_t *lows);
+
+struct SimNative {
+    void *handle;
+    SimNativeStep step;
+    SimNativeSyncLows syncLows;
+};
+
+/*
+ * Translates the levelized netlist into straight-line C (one statement per gate),
+ * compiles it with the system compiler as a shared object and loads it with dlopen.
+ * Compiling takes a while on big netlists, so it pays off on long runs.
+ *
+ * @return NULL when the code couldn't be compiled or loaded
+ */
+SimNative *sim_native_compile(SimNetlist *netlist);
+
+void sim_native_free(SimNative *native);
+
+#endif // SIMULATION_NATIVE_H
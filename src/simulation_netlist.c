@@ -0,0 +1,809 @@
+#include <string.h>
+
+#include "simulation_netlist.h"
+#include "simulation_optimize.h"
+#include "simulation_native.h"
+#include "simulation_vm.h"
+
+static uint32_t netlist_add_net(SimNetlist *netlist) {
+    return netlist->netCount++;
+}
+
+static uint64_t state_to_plane(bool bit) {
+    return bit ? ~0llu : 0;
+}
+
+// a bit of a bus is never Z, it's X
+static SimPinState get_pin_bit(SimPin *pin, size_t bit) {
+    if(pin->width == 1) return pin->state;
+    if((pin->bits.high >> bit) & 1) return PIN_HIGH;
+    if((pin->bits.low >> bit) & 1) return PIN_LOW;
+    return PIN_X;
+}
+
+static void set_pin_bit(SimPin *pin, size_t bit, SimPinState state) {
+    if(pin->width == 1) {
+        pin->state = state;
+        return;
+    }
+
+    uint64_t mask = 1llu << bit;
+    pin->bits.high = (pin->bits.high & ~mask) | (state == PIN_HIGH ? mask : 0);
+    pin->bits.low = (pin->bits.low & ~mask) | (state == PIN_LOW ? mask : 0);
+}
+
+static void netlist_add_gate(SimNetlist *netlist, SimNetGateType type, uint32_t output, uint32_t *inputs, size_t inputCount) {
+    SimNetGate gate = {
+        .type = type,
+        .output = output,
+        .inputs = alloc(inputCount*sizeof(uint32_t)),
+        .inputCount = inputCount,
+    };
+    memcpy(gate.inputs, inputs, inputCount*sizeof(uint32_t));
+    da_append(&netlist->gates, gate);
+}
+
+static void netlist_add_sequential(SimNetlist *netlist, SimChip *chip, uint32_t *inputs, uint32_t *outputs) {
+    SimNetSequential sequential = {
+        .type = chip->type == SIM_CHIP_SR_LATCH ? SIM_NET_SR_LATCH : SIM_NET_REGISTER,
+        .inputCount = chip->inputs.count,
+        .width = chip->outputs.count,
+    };
+
+    // a flip-flop is a register of one bit that is always enabled
+    if(chip->type == SIM_CHIP_DFF) {
+        sequential.inputCount = 3;
+        sequential.inputs = alloc(3*sizeof(uint32_t));
+        sequential.inputs[0] = inputs[0];
+        sequential.inputs[1] = SIM_NET_HIGH;
+        sequential.inputs[2] = inputs[1];
+    } else {
+        sequential.inputs = alloc(sequential.inputCount*sizeof(uint32_t));
+        memcpy(sequential.inputs, inputs, sequential.inputCount*sizeof(uint32_t));
+    }
+
+    sequential.outputs = alloc(sequential.width*sizeof(uint32_t));
+    memcpy(sequential.outputs, outputs, sequential.width*sizeof(uint32_t));
+    sequential.next = alloc(sequential.width*sizeof(SimLogic));
+    sequential.sampled = alloc((sequential.width + 1)*sizeof(SimLogic));
+
+    da_append(&netlist->sequential, sequential);
+}
+
+// a register loads the inputs it had before the pass that changed its clock, like a real
+// flip-flop that needs them stable before the edge. Reading them at the edge goes wrong
+// when a data input is driven by the clock: once the optimizer removes the buffers in
+// between both are the same net and the data already has the new value
+static void sample_registers(SimNetlist *netlist) {
+    for(size_t i = 0; i < netlist->sequential.count; i++) {
+        SimNetSequential *sequential = &netlist->sequential.items[i];
+        if(sequential->type != SIM_NET_REGISTER) continue;
+        for(size_t j = 0; j <= sequential->width; j++) {
+            uint32_t net = sequential->inputs[j];
+            sequential->sampled[j] = (SimLogic){
+                .high = netlist->values[net],
+                .low = netlist->fourState ? netlist->lows[net] : ~netlist->values[net],
+            };
+        }
+    }
+}
+
+size_t *sim_netlist_get_drivers(SimNetlist *netlist) {
+    size_t *drivers = alloc(netlist->netCount*sizeof(size_t));
+    for(size_t i = 0; i < netlist->netCount; i++) {
+        drivers[i] = SIZE_MAX;
+    }
+
+    for(size_t i = 0; i < netlist->gates.count; i++) {
+        drivers[netlist->gates.items[i].output] = i;
+    }
+
+    return drivers;
+}
+
+// sorts the gates so every gate goes after the gates that drive its inputs (Kahn's algorithm)
+// the gates that are part of a loop can't be sorted, so they go at the end
+static void netlist_levelize(SimNetlist *netlist) {
+    size_t gateCount = netlist->gates.count;
+    size_t *drivers = sim_netlist_get_drivers(netlist);
+
+    // number of inputs of each gate driven by a gate that hasn't been sorted yet
+    size_t *pending = alloc(gateCount*sizeof(size_t));
+    // the gates that read the output of each gate, stored one after the other
+    size_t *consumersStart = alloc((gateCount + 1)*sizeof(size_t));
+    for(size_t i = 0; i < gateCount; i++) {
+        SimNetGate *gate = &netlist->gates.items[i];
+        for(size_t j = 0; j < gate->inputCount; j++) {
+            size_t driver = drivers[gate->inputs[j]];
+            if(driver == SIZE_MAX) continue;
+            pending[i]++;
+            consumersStart[driver + 1]++;
+        }
+    }
+    for(size_t i = 0; i < gateCount; i++) {
+        consumersStart[i + 1] += consumersStart[i];
+    }
+
+    size_t *consumers = alloc(consumersStart[gateCount]*sizeof(size_t));
+    size_t *consumersCount = alloc(gateCount*sizeof(size_t));
+    for(size_t i = 0; i < gateCount; i++) {
+        SimNetGate *gate = &netlist->gates.items[i];
+        for(size_t j = 0; j < gate->inputCount; j++) {
+            size_t driver = drivers[gate->inputs[j]];
+            if(driver == SIZE_MAX) continue;
+            consumers[consumersStart[driver] + consumersCount[driver]++] = i;
+        }
+    }
+
+    // the order array is used as the queue too
+    size_t *order = alloc(gateCount*sizeof(size_t));
+    size_t ordered = 0;
+    for(size_t i = 0; i < gateCount; i++) {
+        if(pending[i] == 0) order[ordered++] = i;
+    }
+
+    for(size_t head = 0; head < ordered; head++) {
+        size_t gate = order[head];
+        for(size_t i = consumersStart[gate]; i < consumersStart[gate + 1]; i++) {
+            size_t consumer = consumers[i];
+            if(--pending[consumer] == 0) order[ordered++] = consumer;
+        }
+    }
+
+    netlist->hasFeedback = ordered < gateCount;
+    for(size_t i = 0; i < gateCount; i++) {
+        bool feedback = pending[i] > 0;
+        netlist->gates.items[i].feedback = feedback;
+        if(feedback) order[ordered++] = i;
+    }
+
+    SimNetGate *sorted = alloc(netlist->gates.capacity*sizeof(SimNetGate));
+    for(size_t i = 0; i < gateCount; i++) {
+        sorted[i] = netlist->gates.items[order[i]];
+    }
+    free(netlist->gates.items);
+    netlist->gates.items = sorted;
+
+    free(order);
+    free(consumersCount);
+    free(consumers);
+    free(consumersStart);
+    free(pending);
+    free(drivers);
+}
+
+static void gate_free(SimNetGate *gate) {
+    free(gate->inputs);
+    free(gate->table);
+    free(gate->program);
+}
+
+void sim_netlist_remove_gates(SimNetlist *netlist, bool *removed) {
+    size_t count = 0;
+    for(size_t i = 0; i < netlist->gates.count; i++) {
+        if(removed[i]) {
+            gate_free(&netlist->gates.items[i]);
+        } else {
+            netlist->gates.items[count++] = netlist->gates.items[i];
+        }
+    }
+    netlist->gates.count = count;
+
+    netlist_levelize(netlist);
+}
+
+SimNetlist *sim_netlist_compile(Set *chips, SimNetlistOptions options) {
+    SimNetlist *netlist = alloc(sizeof(SimNetlist));
+    netlist->lanes = 1;
+    netlist->fourState = options.fourState;
+
+    netlist_add_net(netlist); // SIM_NET_LOW
+    netlist_add_net(netlist); // SIM_NET_HIGH
+    netlist_add_net(netlist); // SIM_NET_FLOATING
+
+    // every output pin gets its own net, a bus gets one for each bit one after the other
+    Map *pinNets = map_new();
+    for(SetItem *item = chips->head; item != NULL; item = item->next) {
+        SimChip *chip = item->data;
+        for(size_t i = 0; i < chip->outputs.count; i++) {
+            SimPin *pin = &chip->outputs.items[i];
+            uint32_t net = netlist_add_net(netlist);
+            for(size_t bit = 1; bit < pin->width; bit++) {
+                netlist_add_net(netlist);
+            }
+            for(size_t bit = 0; bit < pin->width; bit++) {
+                da_append(&netlist->pins, ((SimNetPin){ .pin = pin, .net = net + bit, .bit = bit }));
+            }
+            map_set(pinNets, pin, net);
+        }
+    }
+
+    // then the input pins use the net of the output pin they're connected to
+    for(SetItem *item = chips->head; item != NULL; item = item->next) {
+        SimChip *chip = item->data;
+        for(size_t i = 0; i < chip->outputs.count; i++) {
+            SimPin *pin = &chip->outputs.items[i];
+            size_t net;
+            map_get(pinNets, pin, &net);
+
+            SetItem *connection = pin->connectedPins->head;
+            while(connection != NULL) {
+                map_set(pinNets, connection->data, net);
+                connection = connection->next;
+            }
+        }
+    }
+
+    for(SetItem *item = chips->head; item != NULL; item = item->next) {
+        SimChip *chip = item->data;
+
+        uint32_t inputs[chip->inputs.count + 1];
+        for(size_t i = 0; i < chip->inputs.count; i++) {
+            SimPin *pin = &chip->inputs.items[i];
+            size_t net;
+            // with two-state logic an input pin that is not connected is always low
+            if(!map_get(pinNets, pin, &net)) {
+                net = options.fourState ? SIM_NET_FLOATING : SIM_NET_LOW;
+                // the reserved nets are a single bit, so a bus that isn't connected is never written back
+                if(pin->width > 1) {
+                    inputs[i] = net;
+                    continue;
+                }
+            }
+            inputs[i] = net;
+            for(size_t bit = 0; bit < pin->width; bit++) {
+                da_append(&netlist->pins, ((SimNetPin){ .pin = pin, .net = net + bit, .bit = bit }));
+            }
+        }
+
+        uint32_t outputs[chip->outputs.count + 1];
+        for(size_t i = 0; i < chip->outputs.count; i++) {
+            size_t net;
+            map_get(pinNets, &chip->outputs.items[i], &net);
+            outputs[i] = net;
+        }
+
+        size_t output;
+        switch(chip->type) {
+            case SIM_CHIP_NAND:
+                map_get(pinNets, &chip->outputs.items[0], &output);
+                netlist_add_gate(netlist, SIM_NET_GATE_NAND, output, inputs, 2);
+                break;
+            case SIM_CHIP_AND:
+            case SIM_CHIP_BUF:
+                netlist_add_gate(netlist, SIM_NET_GATE_AND, outputs[0], inputs, chip->inputs.count);
+                break;
+            case SIM_CHIP_OR:
+                netlist_add_gate(netlist, SIM_NET_GATE_OR, outputs[0], inputs, chip->inputs.count);
+                break;
+            case SIM_CHIP_XOR:
+                netlist_add_gate(netlist, SIM_NET_GATE_XOR, outputs[0], inputs, chip->inputs.count);
+                break;
+            case SIM_CHIP_NOR:
+                netlist_add_gate(netlist, SIM_NET_GATE_NOR, outputs[0], inputs, chip->inputs.count);
+                break;
+            case SIM_CHIP_XNOR:
+                netlist_add_gate(netlist, SIM_NET_GATE_XNOR, outputs[0], inputs, chip->inputs.count);
+                break;
+            case SIM_CHIP_NOT:
+                inputs[1] = inputs[0];
+                netlist_add_gate(netlist, SIM_NET_GATE_NAND, outputs[0], inputs, 2);
+                break;
+            // the splitters and mergers are buffers, the optimizer replaces them with the nets they read
+            case SIM_CHIP_SPLITTER:
+                for(size_t i = 0; i < chip->outputs.count; i++) {
+                    uint32_t bit = inputs[0] <= SIM_NET_FLOATING ? inputs[0] : inputs[0] + i;
+                    netlist_add_gate(netlist, SIM_NET_GATE_AND, outputs[i], &bit, 1);
+                }
+                break;
+            case SIM_CHIP_MERGER:
+                for(size_t i = 0; i < chip->inputs.count; i++) {
+                    netlist_add_gate(netlist, SIM_NET_GATE_AND, outputs[0] + i, &inputs[i], 1);
+                }
+                break;
+            case SIM_CHIP_INPUT:
+                map_get(pinNets, &chip->outputs.items[0], &output);
+                da_append(&netlist->inputs, ((SimNetPort){ .chip = chip, .net = output }));
+                break;
+            case SIM_CHIP_CLOCK:
+                map_get(pinNets, &chip->outputs.items[0], &output);
+                da_append(&netlist->clocks, ((SimNetPort){ .chip = chip, .net = output }));
+                break;
+            case SIM_CHIP_DFF:
+            case SIM_CHIP_SR_LATCH:
+            case SIM_CHIP_REGISTER:
+                netlist_add_sequential(netlist, chip, inputs, outputs);
+                break;
+            case SIM_CHIP_OUTPUT:
+                da_append(&netlist->outputs, ((SimNetPort){ .chip = chip, .net = inputs[0] }));
+                break;
+        }
+    }
+    map_free(pinNets);
+
+    netlist->values = alloc(netlist->netCount*sizeof(uint64_t));
+    netlist->lows = alloc(netlist->netCount*sizeof(uint64_t));
+    netlist->values[SIM_NET_HIGH] = ~0llu;
+    if(options.fourState) {
+        // SIM_NET_FLOATING is zero in both planes, so the gates read it as X
+        netlist->lows[SIM_NET_LOW] = ~0llu;
+    }
+    for(size_t i = 0; i < netlist->pins.count; i++) {
+        SimNetPin netPin = netlist->pins.items[i];
+        if(netPin.pin->isInput) continue;
+        SimPinState state = get_pin_bit(netPin.pin, netPin.bit);
+        netlist->values[netPin.net] = state_to_plane(state == PIN_HIGH);
+        if(options.fourState) {
+            netlist->lows[netPin.net] = state_to_plane(state == PIN_LOW);
+        }
+    }
+
+    for(size_t i = 0; i < netlist->sequential.count; i++) {
+        SimNetSequential *sequential = &netlist->sequential.items[i];
+        uint32_t clock = sequential->inputs[sequential->inputCount - 1];
+        sequential->clock = (SimLogic){ .high = netlist->values[clock], .low = netlist->lows[clock] };
+    }
+
+    netlist_levelize(netlist);
+
+    if(options.optimize) {
+        sim_netlist_optimize(netlist);
+    }
+
+    if(options.collapseLuts) {
+        sim_netlist_collapse_luts(netlist);
+    }
+
+    // the optimizer can change the inputs of the registers
+    sample_registers(netlist);
+
+    switch(options.backend) {
+        case SIM_BACKEND_LEVELIZED: break;
+        case SIM_BACKEND_VM:
+            netlist->program = sim_vm_compile(netlist);
+            break;
+        case SIM_BACKEND_NATIVE:
+            netlist->native = sim_native_compile(netlist);
+            if(netlist->native == NULL) {
+                printf("[WARNING] Falling back to the levelized backend\n");
+            }
+            break;
+    }
+
+    return netlist;
+}
+
+void sim_netlist_free(SimNetlist *netlist) {
+    if(netlist->native != NULL) {
+        sim_native_free(netlist->native);
+    }
+    if(netlist->program != NULL) {
+        sim_vm_free(netlist->program);
+    }
+    for(size_t i = 0; i < netlist->gates.count; i++) {
+        gate_free(&netlist->gates.items[i]);
+    }
+    da_free(&netlist->gates);
+    for(size_t i = 0; i < netlist->sequential.count; i++) {
+        SimNetSequential *sequential = &netlist->sequential.items[i];
+        free(sequential->inputs);
+        free(sequential->outputs);
+        free(sequential->next);
+        free(sequential->sampled);
+    }
+    da_free(&netlist->sequential);
+    da_free(&netlist->inputs);
+    da_free(&netlist->clocks);
+    da_free(&netlist->outputs);
+    da_free(&netlist->pins);
+    free(netlist->values);
+    free(netlist->lows);
+    free(netlist->stuckLow);
+    free(netlist->stuckHigh);
+    free(netlist);
+}
+
+uint64_t sim_net_lut_eval(SimNetGate *gate, uint32_t *inputs, uint64_t *values, size_t lanes) {
+    if(lanes > 1) return sim_net_lut_run(gate->program, gate->programCount, inputs, gate->inputCount, values);
+
+    size_t index = 0;
+    for(size_t i = 0; i < gate->inputCount; i++) {
+        index |= (values[inputs[i]] & 1) << i;
+    }
+    return (gate->table[index / 64] >> (index % 64)) & 1;
+}
+
+bool sim_net_gate_is_inverted(SimNetGateType type) {
+    return type == SIM_NET_GATE_NOR || type == SIM_NET_GATE_XNOR;
+}
+
+uint64_t sim_net_wide_gate_eval(SimNetGateType type, uint32_t *inputs, size_t count, uint64_t *values) {
+    uint64_t result = values[inputs[0]];
+    switch(type) {
+        case SIM_NET_GATE_AND:
+            for(size_t i = 1; i < count; i++) result &= values[inputs[i]];
+            break;
+        case SIM_NET_GATE_OR:
+        case SIM_NET_GATE_NOR:
+            for(size_t i = 1; i < count; i++) result |= values[inputs[i]];
+            break;
+        case SIM_NET_GATE_XOR:
+        case SIM_NET_GATE_XNOR:
+            for(size_t i = 1; i < count; i++) result ^= values[inputs[i]];
+            break;
+        default:
+            panic("Not a wide gate");
+    }
+
+    return sim_net_gate_is_inverted(type) ? ~result : result;
+}
+
+uint64_t sim_net_gate_eval(SimNetlist *netlist, SimNetGate *gate, uint64_t *values) {
+    switch(gate->type) {
+        case SIM_NET_GATE_NAND:
+            return ~(values[gate->inputs[0]] & values[gate->inputs[1]]);
+        case SIM_NET_GATE_LUT:
+            return sim_net_lut_eval(gate, gate->inputs, values, netlist->lanes);
+        default:
+            return sim_net_wide_gate_eval(gate->type, gate->inputs, gate->inputCount, values);
+    }
+}
+
+static SimLogic get_logic(uint64_t *values, uint64_t *lows, uint32_t net) {
+    return (SimLogic){ .high = values[net], .low = lows[net] };
+}
+
+SimLogic sim_net_wide_gate_eval_four_state(SimNetGateType type, uint32_t *inputs, size_t count, uint64_t *values, uint64_t *lows) {
+    SimLogic result = get_logic(values, lows, inputs[0]);
+    switch(type) {
+        case SIM_NET_GATE_AND:
+            for(size_t i = 1; i < count; i++) result = sim_logic_and(result, get_logic(values, lows, inputs[i]));
+            break;
+        case SIM_NET_GATE_OR:
+        case SIM_NET_GATE_NOR:
+            for(size_t i = 1; i < count; i++) result = sim_logic_or(result, get_logic(values, lows, inputs[i]));
+            break;
+        case SIM_NET_GATE_XOR:
+        case SIM_NET_GATE_XNOR:
+            for(size_t i = 1; i < count; i++) result = sim_logic_xor(result, get_logic(values, lows, inputs[i]));
+            break;
+        default:
+            panic("Not a wide gate");
+    }
+
+    return sim_net_gate_is_inverted(type) ? sim_logic_not(result) : result;
+}
+
+SimLogic sim_net_gate_eval_four_state(SimNetlist *netlist, SimNetGate *gate, uint64_t *values, uint64_t *lows) {
+    (void)netlist;
+    switch(gate->type) {
+        case SIM_NET_GATE_NAND:
+            return sim_logic_nand(
+                get_logic(values, lows, gate->inputs[0]),
+                get_logic(values, lows, gate->inputs[1])
+            );
+        case SIM_NET_GATE_LUT:
+            panic("The LUT gates don't support four-state logic");
+        default:
+            return sim_net_wide_gate_eval_four_state(gate->type, gate->inputs, gate->inputCount, values, lows);
+    }
+}
+
+// @return the value the net ends up with after applying its faults
+static SimLogic apply_faults(SimNetlist *netlist, uint32_t net, SimLogic logic) {
+    if(netlist->stuckLow == NULL) return logic;
+    uint64_t stuckLow = netlist->stuckLow[net];
+    uint64_t stuckHigh = netlist->stuckHigh[net];
+    return (SimLogic){
+        .high = (logic.high & ~stuckLow) | stuckHigh,
+        .low = (logic.low & ~stuckHigh) | stuckLow,
+    };
+}
+
+static bool eval_pass_four_state(SimNetlist *netlist) {
+    uint64_t changed = 0;
+    uint64_t *values = netlist->values;
+    uint64_t *lows = netlist->lows;
+
+    for(size_t i = 0; i < netlist->gates.count; i++) {
+        SimNetGate *gate = &netlist->gates.items[i];
+        SimLogic logic = sim_net_gate_eval_four_state(netlist, gate, values, lows);
+        logic = apply_faults(netlist, gate->output, logic);
+        changed |= (values[gate->output] ^ logic.high) | (lows[gate->output] ^ logic.low);
+        values[gate->output] = logic.high;
+        lows[gate->output] = logic.low;
+    }
+
+    return changed != 0;
+}
+
+// @return true if any net changed
+static bool eval_pass(SimNetlist *netlist) {
+    bool faults = netlist->stuckLow != NULL;
+    if(netlist->native != NULL && !faults) {
+        return netlist->native->step(netlist->values, netlist->lows, netlist->lanes) != 0;
+    }
+    if(netlist->program != NULL && !faults) {
+        return sim_vm_run(netlist->program, netlist->values, netlist->lows, netlist->lanes) != 0;
+    }
+    if(netlist->fourState) {
+        return eval_pass_four_state(netlist);
+    }
+
+    uint64_t changed = 0;
+    uint64_t *values = netlist->values;
+
+    for(size_t i = 0; i < netlist->gates.count; i++) {
+        SimNetGate *gate = &netlist->gates.items[i];
+        uint64_t value = sim_net_gate_eval(netlist, gate, values);
+        if(faults) {
+            value = (value & ~netlist->stuckLow[gate->output]) | netlist->stuckHigh[gate->output];
+        }
+        changed |= values[gate->output] ^ value;
+        values[gate->output] = value;
+    }
+
+    return changed != 0;
+}
+
+static void update_register(SimNetlist *netlist, SimNetSequential *sequential) {
+    uint64_t *values = netlist->values;
+    uint64_t *lows = netlist->lows;
+    uint32_t clock = sequential->inputs[sequential->width + 1];
+    SimLogic previous = sequential->clock;
+    SimLogic enable = sequential->sampled[sequential->width];
+
+    if(!netlist->fourState) {
+        uint64_t load = ~previous.high & values[clock] & enable.high;
+        sequential->clock.high = values[clock];
+        for(size_t i = 0; i < sequential->width; i++) {
+            uint64_t data = sequential->sampled[i].high;
+            uint64_t stored = values[sequential->outputs[i]];
+            sequential->next[i].high = (stored & ~load) | (data & load);
+        }
+        return;
+    }
+
+    // only a known LOW to HIGH change is an edge, like in the interpreter
+    uint64_t rising = previous.low & values[clock];
+    uint64_t load = rising & enable.high;
+    uint64_t hold = ~rising | enable.low;
+    // when the enable is unknown the bits that don't change stay known
+    uint64_t maybe = rising & ~enable.high & ~enable.low;
+    sequential->clock = (SimLogic){ .high = values[clock], .low = lows[clock] };
+
+    for(size_t i = 0; i < sequential->width; i++) {
+        SimLogic data = sequential->sampled[i];
+        SimLogic stored = { .high = values[sequential->outputs[i]], .low = lows[sequential->outputs[i]] };
+        sequential->next[i] = (SimLogic){
+            .high = (load & data.high) | (hold & stored.high) | (maybe & data.high & stored.high),
+            .low = (load & data.low) | (hold & stored.low) | (maybe & data.low & stored.low),
+        };
+    }
+}
+
+static void update_sr_latch(SimNetlist *netlist, SimNetSequential *sequential) {
+    uint64_t *values = netlist->values;
+    uint64_t *lows = netlist->lows;
+    uint32_t set = sequential->inputs[0];
+    uint32_t reset = sequential->inputs[1];
+    uint32_t output = sequential->outputs[0];
+
+    if(!netlist->fourState) {
+        sequential->next[0].high = ~values[reset] & (values[set] | values[output]);
+        return;
+    }
+
+    uint64_t hold = lows[set] & lows[reset];
+    sequential->next[0] = (SimLogic){
+        .high = (values[set] & lows[reset]) | (hold & values[output]),
+        .low = (lows[set] & values[reset]) | (hold & lows[output]),
+    };
+}
+
+// @return true if any output of a sequential chip changed
+static bool update_sequential(SimNetlist *netlist) {
+    // first every chip reads its inputs and then the outputs are written, this way
+    // a register that reads the output of another one gets the old value
+    for(size_t i = 0; i < netlist->sequential.count; i++) {
+        SimNetSequential *sequential = &netlist->sequential.items[i];
+        switch(sequential->type) {
+            case SIM_NET_REGISTER:
+                update_register(netlist, sequential);
+                break;
+            case SIM_NET_SR_LATCH:
+                update_sr_latch(netlist, sequential);
+                break;
+        }
+    }
+
+    uint64_t changed = 0;
+    for(size_t i = 0; i < netlist->sequential.count; i++) {
+        SimNetSequential *sequential = &netlist->sequential.items[i];
+        for(size_t j = 0; j < sequential->width; j++) {
+            uint32_t output = sequential->outputs[j];
+            SimLogic next = apply_faults(netlist, output, sequential->next[j]);
+            changed |= netlist->values[output] ^ next.high;
+            netlist->values[output] = next.high;
+            if(netlist->fourState) {
+                changed |= netlist->lows[output] ^ next.low;
+                netlist->lows[output] = next.low;
+            }
+        }
+    }
+    sample_registers(netlist);
+
+    return changed != 0;
+}
+
+void sim_netlist_eval(SimNetlist *netlist) {
+    if(!netlist->hasFeedback && netlist->sequential.count == 0) {
+        eval_pass(netlist);
+        return;
+    }
+
+    // the registers clocked straight from an input see the edge before the gates
+    // react to it, they load the inputs sampled when the netlist last settled
+    update_sequential(netlist);
+
+    // the gates inside a loop were evaluated with old values and the sequential
+    // chips change the inputs of the gates, so we repeat the pass until the
+    // values stop changing
+    for(size_t i = 0; i < SIM_NETLIST_MAX_PASSES; i++) {
+        bool changed = eval_pass(netlist) && netlist->hasFeedback;
+        changed |= update_sequential(netlist);
+        if(!changed) return;
+    }
+
+    printf("[WARNING] The netlist didn't settle after %d passes\n", SIM_NETLIST_MAX_PASSES);
+}
+
+// the native code skips the low plane of the nets that can't be X, it's written
+// before something outside of the step reads all of them
+static void sync_lows(SimNetlist *netlist) {
+    if(netlist->native != NULL && netlist->fourState) {
+        netlist->native->syncLows(netlist->values, netlist->lows);
+    }
+}
+
+static void set_net(SimNetlist *netlist, uint32_t net, uint64_t value) {
+    SimLogic logic = apply_faults(netlist, net, (SimLogic){ .high = value, .low = ~value });
+    netlist->values[net] = logic.high;
+    netlist->lows[net] = logic.low;
+}
+
+void sim_netlist_inject_fault(SimNetlist *netlist, uint32_t net, uint64_t lanes, bool high) {
+    assert(net < netlist->netCount && "Net out of bounds");
+    if(netlist->stuckLow == NULL) {
+        netlist->stuckLow = alloc(netlist->netCount*sizeof(uint64_t));
+        netlist->stuckHigh = alloc(netlist->netCount*sizeof(uint64_t));
+    }
+    // the levelized evaluation reads the low plane of every net from now on
+    sync_lows(netlist);
+
+    // a lane can only be stuck at one value
+    if(high) {
+        netlist->stuckHigh[net] |= lanes;
+        netlist->stuckLow[net] &= ~lanes;
+    } else {
+        netlist->stuckLow[net] |= lanes;
+        netlist->stuckHigh[net] &= ~lanes;
+    }
+
+    SimLogic logic = apply_faults(netlist, net, get_logic(netlist->values, netlist->lows, net));
+    netlist->values[net] = logic.high;
+    netlist->lows[net] = logic.low;
+}
+
+void sim_netlist_clear_faults(SimNetlist *netlist) {
+    free(netlist->stuckLow);
+    free(netlist->stuckHigh);
+    netlist->stuckLow = NULL;
+    netlist->stuckHigh = NULL;
+}
+
+void sim_netlist_set_input(SimNetlist *netlist, size_t index, uint64_t value) {
+    assert(index < netlist->inputs.count && "Input index out of bounds");
+    set_net(netlist, netlist->inputs.items[index].net, value);
+}
+
+uint64_t sim_netlist_get_output(SimNetlist *netlist, size_t index) {
+    assert(index < netlist->outputs.count && "Output index out of bounds");
+    return netlist->values[netlist->outputs.items[index].net];
+}
+
+uint64_t sim_netlist_get_output_unknown(SimNetlist *netlist, size_t index) {
+    assert(index < netlist->outputs.count && "Output index out of bounds");
+    if(!netlist->fourState) return 0;
+    return sim_logic_unknown(get_logic(netlist->values, netlist->lows, netlist->outputs.items[index].net));
+}
+
+static void toggle_clocks(SimNetlist *netlist) {
+    for(size_t i = 0; i < netlist->clocks.count; i++) {
+        uint32_t net = netlist->clocks.items[i].net;
+        set_net(netlist, net, ~netlist->values[net]);
+    }
+}
+
+size_t sim_netlist_run_cycles(SimNetlist *netlist, size_t cycles, SimNetlistWatch watch, void *data) {
+    for(size_t cycle = 0; cycle < cycles; cycle++) {
+        for(size_t edge = 0; edge < 2; edge++) {
+            toggle_clocks(netlist);
+            sim_netlist_eval(netlist);
+            if(watch != NULL && watch(netlist, data)) return cycle + 1;
+        }
+    }
+
+    return cycles;
+}
+
+static SimPinState net_to_state(SimNetlist *netlist, uint32_t net) {
+    if(!netlist->fourState) return netlist->values[net] & 1;
+    if(net == SIM_NET_FLOATING) return PIN_Z;
+    if(netlist->values[net] & 1) return PIN_HIGH;
+    if(netlist->lows[net] & 1) return PIN_LOW;
+    return PIN_X;
+}
+
+void sim_netlist_write_back(SimNetlist *netlist) {
+    sync_lows(netlist);
+    // the nets of removed gates are not updated anymore, so they're skipped
+    bool *live = alloc(netlist->netCount*sizeof(bool));
+    live[SIM_NET_LOW] = live[SIM_NET_HIGH] = live[SIM_NET_FLOATING] = true;
+    for(size_t i = 0; i < netlist->inputs.count; i++) {
+        live[netlist->inputs.items[i].net] = true;
+    }
+    for(size_t i = 0; i < netlist->clocks.count; i++) {
+        live[netlist->clocks.items[i].net] = true;
+    }
+    for(size_t i = 0; i < netlist->sequential.count; i++) {
+        SimNetSequential *sequential = &netlist->sequential.items[i];
+        for(size_t j = 0; j < sequential->width; j++) {
+            live[sequential->outputs[j]] = true;
+        }
+    }
+    for(size_t i = 0; i < netlist->gates.count; i++) {
+        live[netlist->gates.items[i].output] = true;
+    }
+
+    for(size_t i = 0; i < netlist->pins.count; i++) {
+        SimNetPin netPin = netlist->pins.items[i];
+        if(!live[netPin.net]) continue;
+        set_pin_bit(netPin.pin, netPin.bit, net_to_state(netlist, netPin.net));
+    }
+
+    free(live);
+}
+
+SimNetlistState sim_netlist_save_state(SimNetlist *netlist) {
+    sync_lows(netlist);
+    size_t size = netlist->netCount*sizeof(uint64_t);
+    SimNetlistState state = {
+        .values = alloc(size),
+        .lows = alloc(size),
+        .clocks = alloc((netlist->sequential.count + 1)*sizeof(SimLogic)),
+    };
+    memcpy(state.values, netlist->values, size);
+    memcpy(state.lows, netlist->lows, size);
+    for(size_t i = 0; i < netlist->sequential.count; i++) {
+        state.clocks[i] = netlist->sequential.items[i].clock;
+    }
+    return state;
+}
+
+void sim_netlist_load_state(SimNetlist *netlist, SimNetlistState *state) {
+    size_t size = netlist->netCount*sizeof(uint64_t);
+    memcpy(netlist->values, state->values, size);
+    memcpy(netlist->lows, state->lows, size);
+    for(size_t i = 0; i < netlist->sequential.count; i++) {
+        netlist->sequential.items[i].clock = state->clocks[i];
+    }
+    // the state is always saved after the netlist settled, when the samples match the nets
+    sample_registers(netlist);
+}
+
+void sim_netlist_state_free(SimNetlistState *state) {
+    free(state->values);
+    free(state->lows);
+    free(state->clocks);
+}
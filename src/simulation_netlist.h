@@ -0,0 +1,362 @@
+#ifndef SIMULATION_NETLIST_H
+#define SIMULATION_NETLIST_H
+
+#include <stdint.h>
+#include "simulation.h"
+#include "simulation_logic.h"
+
+/*
+ * The netlist is a flattened copy of the chips of a simulation, made to
+ * evaluate them as fast as possible.
+ *
+ * Every output pin becomes a "net" and every chip becomes a "gate" that
+ * reads some nets and writes one. The gates are sorted so every gate is
+ * evaluated after the gates that drive its inputs (levelized), this way
+ * a single pass over the array is enough to settle the whole circuit.
+ *
+ * The sequential chips (flip-flops, latches and registers) aren't gates, their
+ * outputs are nets that only change when sim_netlist_eval updates them after
+ * the gates settle, so the loops that go through them don't count as feedback.
+ *
+ * The value of a net is a uint64_t where every bit is an independent
+ * simulation "lane", only the first "lanes" bits are meaningful.
+ *
+ * With four-state logic enabled every net has a second bit-plane called
+ * "lows" (see simulation_logic.h): a lane is HIGH when its bit is set in
+ * "values", LOW when it's set in "lows" and X when it's set in neither.
+ * The "values" plane alone is the two-state simulation.
+ */
+
+// these nets exist in every netlist
+#define SIM_NET_LOW 0
+#define SIM_NET_HIGH 1
+// read by the input pins that aren't connected, it's Z with four-state logic (read as X by
+// the gates) and LOW otherwise
+#define SIM_NET_FLOATING 2
+
+#define SIM_LUT_MAX_INPUTS 16
+// a LUT is only made when its program has at most this many operations
+#define SIM_LUT_MAX_OPS 64
+
+// max number of passes used to settle a netlist with feedback loops
+#define SIM_NETLIST_MAX_PASSES 1000
+
+typedef struct SimNative SimNative;
+typedef struct SimVMProgram SimVMProgram;
+
+typedef enum {
+    // walks the gates array calling sim_net_gate_eval
+    SIM_BACKEND_LEVELIZED,
+    // runs the netlist as bytecode (see simulation_vm.h)
+    SIM_BACKEND_VM,
+    // compiles the netlist to C and loads it (see simulation_native.h)
+    SIM_BACKEND_NATIVE,
+} SimNetlistBackend;
+
+typedef enum {
+    // always has two inputs, an inverter is a NAND with both inputs in the same net
+    SIM_NET_GATE_NAND,
+    SIM_NET_GATE_LUT,
+    // wide gates, they can have any number of inputs (a buffer is an AND with one input)
+    SIM_NET_GATE_AND,
+    SIM_NET_GATE_OR,
+    SIM_NET_GATE_XOR,
+    SIM_NET_GATE_NOR,
+    SIM_NET_GATE_XNOR,
+} SimNetGateType;
+
+// an operation of the program of a LUT gate, see sim_net_lut_run
+typedef enum {
+    SIM_LUT_OP_ZERO,
+    SIM_LUT_OP_ONE,
+    // a
+    SIM_LUT_OP_COPY,
+    // ~a
+    SIM_LUT_OP_NOT,
+    // a & b
+    SIM_LUT_OP_AND,
+    // a | b
+    SIM_LUT_OP_OR,
+    // a ^ b
+    SIM_LUT_OP_XOR,
+    // a & ~b
+    SIM_LUT_OP_AND_NOT,
+    // a | ~b
+    SIM_LUT_OP_OR_NOT,
+    // b where a is LOW and c where a is HIGH
+    SIM_LUT_OP_MUX,
+} SimLutOpType;
+
+// the operands are the inputs of the gate (below its input count) or the
+// results of the operations before this one (the inputs are followed by them)
+typedef struct {
+    uint8_t type;
+    uint8_t a;
+    uint8_t b;
+    uint8_t c;
+} SimLutOp;
+
+typedef struct {
+    SimNetGateType type;
+    uint32_t output;
+    uint32_t *inputs;
+    size_t inputCount;
+    // truth table of the LUT gates, bit "i" is the output for the input combination "i"
+    uint64_t *table;
+    // the same function as "table" made of word-wide operations, it evaluates every
+    // lane at once instead of looking up the table once per lane. The result is the last one
+    SimLutOp *program;
+    size_t programCount;
+    // true when the gate is part of a feedback loop
+    bool feedback;
+} SimNetGate;
+
+typedef struct {
+    SimNetGate *items;
+    size_t count;
+    size_t capacity;
+} SimNetGateArray;
+
+typedef enum {
+    // edge-triggered, used for SIM_CHIP_DFF (enable tied HIGH) and SIM_CHIP_REGISTER
+    SIM_NET_REGISTER,
+    // level-sensitive SIM_CHIP_SR_LATCH, with two-state logic R wins when both inputs are HIGH
+    SIM_NET_SR_LATCH,
+} SimNetSequentialType;
+
+typedef struct {
+    SimNetSequentialType type;
+    // registers: D..., enable, clock. Latches: S, R
+    uint32_t *inputs;
+    size_t inputCount;
+    uint32_t *outputs;
+    size_t width;
+    // value of the clock the last time the register was updated
+    SimLogic clock;
+    // registers: the data and enable inputs from before the last pass, loaded on an edge
+    SimLogic *sampled;
+    // the new outputs are calculated for all the chips before writing any of them
+    SimLogic *next;
+} SimNetSequential;
+
+typedef struct {
+    SimNetSequential *items;
+    size_t count;
+    size_t capacity;
+} SimNetSequentialArray;
+
+// connects a net with the chip that reads or drives it
+typedef struct {
+    SimChip *chip;
+    uint32_t net;
+} SimNetPort;
+
+typedef struct {
+    SimNetPort *items;
+    size_t count;
+    size_t capacity;
+} SimNetPortArray;
+
+// used to copy the values of the nets back to the pins, a bus has one for each bit
+typedef struct {
+    SimPin *pin;
+    uint32_t net;
+    size_t bit;
+} SimNetPin;
+
+typedef struct {
+    SimNetPin *items;
+    size_t count;
+    size_t capacity;
+} SimNetPinArray;
+
+typedef struct {
+    // folds constants and removes redundant and dead gates
+    bool optimize;
+    // collapses small combinational cones into a single LUT gate, ignored with four-state logic
+    bool collapseLuts;
+    // simulates X and Z besides LOW and HIGH, costs about twice as much
+    bool fourState;
+    SimNetlistBackend backend;
+} SimNetlistOptions;
+
+typedef struct {
+    size_t netCount;
+    uint64_t *values;
+    uint64_t *lows;
+    size_t lanes;
+    bool fourState;
+
+    bool hasFeedback;
+    SimNetGateArray gates;
+    SimNetSequentialArray sequential;
+
+    // nets driven by SIM_CHIP_INPUT chips
+    SimNetPortArray inputs;
+    // nets read by SIM_CHIP_OUTPUT chips
+    SimNetPortArray outputs;
+    // nets driven by SIM_CHIP_CLOCK chips
+    SimNetPortArray clocks;
+    SimNetPinArray pins;
+
+    // lanes where each net is forced LOW or HIGH, NULL until a fault is injected
+    uint64_t *stuckLow;
+    uint64_t *stuckHigh;
+
+    // NULL unless the netlist uses SIM_BACKEND_NATIVE
+    SimNative *native;
+    // NULL unless the netlist uses SIM_BACKEND_VM
+    SimVMProgram *program;
+} SimNetlist;
+
+/*
+ * Creates a netlist from a set of SimChip.
+ * The nets start with the current state of the pins.
+ *
+ * If the backend can't be created, the netlist falls back to SIM_BACKEND_LEVELIZED.
+ */
+SimNetlist *sim_netlist_compile(Set *chips, SimNetlistOptions options);
+
+void sim_netlist_free(SimNetlist *netlist);
+
+/*
+ * Forces the net to LOW (or HIGH when "high") in the lanes set in "lanes", like a
+ * stuck-at fault on the output pin that drives it. The net keeps that value no matter
+ * what its gate, sequential chip or input writes, until sim_netlist_clear_faults.
+ *
+ * The backends don't know about the faults, so while there are any the gates are
+ * evaluated like with SIM_BACKEND_LEVELIZED.
+ */
+void sim_netlist_inject_fault(SimNetlist *netlist, uint32_t net, uint64_t lanes, bool high);
+
+void sim_netlist_clear_faults(SimNetlist *netlist);
+
+/*
+ * Evaluates all the gates until the netlist settles, updating the
+ * sequential chips on the way.
+ */
+void sim_netlist_eval(SimNetlist *netlist);
+
+/*
+ * Sets the value of the input, inputs are never unknown.
+ */
+void sim_netlist_set_input(SimNetlist *netlist, size_t index, uint64_t value);
+
+/*
+ * @return the value plane of the output, the unknown lanes are zero
+ */
+uint64_t sim_netlist_get_output(SimNetlist *netlist, size_t index);
+
+/*
+ * @return the lanes of the output that are X, it's always zero with two-state logic
+ */
+uint64_t sim_netlist_get_output_unknown(SimNetlist *netlist, size_t index);
+
+/*
+ * Called after every edge of the clock, the run stops when it returns true.
+ */
+typedef bool (*SimNetlistWatch)(SimNetlist *netlist, void *data);
+
+/*
+ * Advances "cycles" clock cycles without going through the chips. Every cycle
+ * toggles the clocks twice and evaluates the netlist after each edge.
+ * "watch" can be NULL.
+ *
+ * @return the number of cycles that were run, including the one where "watch" fired
+ */
+size_t sim_netlist_run_cycles(SimNetlist *netlist, size_t cycles, SimNetlistWatch watch, void *data);
+
+/*
+ * Copies the first lane of every net to the pins it came from.
+ * Pins whose gates were removed by an optimization keep their old state.
+ */
+void sim_netlist_write_back(SimNetlist *netlist);
+
+// the values of the nets and the last clock seen by every register
+typedef struct {
+    uint64_t *values;
+    uint64_t *lows;
+    SimLogic *clocks;
+} SimNetlistState;
+
+/*
+ * Copies the current state, so the netlist can start from it again with
+ * sim_netlist_load_state. The faults aren't part of the state.
+ */
+SimNetlistState sim_netlist_save_state(SimNetlist *netlist);
+
+void sim_netlist_load_state(SimNetlist *netlist, SimNetlistState *state);
+
+void sim_netlist_state_free(SimNetlistState *state);
+
+/*
+ * Calculates the output of the gate using "values" as the value of the nets.
+ */
+uint64_t sim_net_gate_eval(SimNetlist *netlist, SimNetGate *gate, uint64_t *values);
+
+/*
+ * Same as sim_net_gate_eval but with the two planes of four-state logic.
+ * There are no LUT gates with four-state logic (see sim_netlist_collapse_luts).
+ */
+SimLogic sim_net_gate_eval_four_state(SimNetlist *netlist, SimNetGate *gate, uint64_t *values, uint64_t *lows);
+
+/*
+ * Evaluates a LUT gate: with a single lane it looks up the table, with more it runs its program.
+ */
+uint64_t sim_net_lut_eval(SimNetGate *gate, uint32_t *inputs, uint64_t *values, size_t lanes);
+
+/*
+ * Runs the program of a LUT gate reading "inputs" from "values", every lane at once.
+ * It's inline because the backends call it for every LUT gate.
+ */
+static inline uint64_t sim_net_lut_run(SimLutOp *program, size_t count, uint32_t *inputs, size_t inputCount, uint64_t *values) {
+    uint64_t operands[SIM_LUT_MAX_INPUTS + SIM_LUT_MAX_OPS];
+    for(size_t i = 0; i < inputCount; i++) {
+        operands[i] = values[inputs[i]];
+    }
+
+    uint64_t *results = &operands[inputCount];
+    for(size_t i = 0; i < count; i++) {
+        SimLutOp op = program[i];
+        uint64_t a = operands[op.a], b = operands[op.b];
+        switch(op.type) {
+            case SIM_LUT_OP_ZERO: results[i] = 0; break;
+            case SIM_LUT_OP_ONE: results[i] = ~0llu; break;
+            case SIM_LUT_OP_COPY: results[i] = a; break;
+            case SIM_LUT_OP_NOT: results[i] = ~a; break;
+            case SIM_LUT_OP_AND: results[i] = a & b; break;
+            case SIM_LUT_OP_OR: results[i] = a | b; break;
+            case SIM_LUT_OP_XOR: results[i] = a ^ b; break;
+            case SIM_LUT_OP_AND_NOT: results[i] = a & ~b; break;
+            case SIM_LUT_OP_OR_NOT: results[i] = a | ~b; break;
+            case SIM_LUT_OP_MUX: results[i] = b ^ (a & (b ^ operands[op.c])); break;
+        }
+    }
+    return results[count - 1];
+}
+
+/*
+ * Evaluates a wide gate (AND, OR, XOR, NOR or XNOR) reading "inputs" from "values".
+ */
+uint64_t sim_net_wide_gate_eval(SimNetGateType type, uint32_t *inputs, size_t count, uint64_t *values);
+
+SimLogic sim_net_wide_gate_eval_four_state(SimNetGateType type, uint32_t *inputs, size_t count, uint64_t *values, uint64_t *lows);
+
+/*
+ * @return true for the gates that invert the result of the reduction (NOR and XNOR)
+ */
+bool sim_net_gate_is_inverted(SimNetGateType type);
+
+/*
+ * Frees and removes every gate marked in "removed" (indexed like the gates array)
+ * and sorts the remaining gates again.
+ */
+void sim_netlist_remove_gates(SimNetlist *netlist, bool *removed);
+
+/*
+ * @return an array with the index of the gate that drives each net or SIZE_MAX
+ * when the net isn't driven by a gate. Should be freed by the caller.
+ */
+size_t *sim_netlist_get_drivers(SimNetlist *netlist);
+
+#endif // SIMULATION_NETLIST_H
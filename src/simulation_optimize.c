@@ -0,0 +1,613 @@
+#include <string.h>
+
+#include "simulation_optimize.h"
+
+// ----------------------- //
+// Simplification of gates //
+// ----------------------- //
+
+static uint32_t resolve_net(uint32_t *aliases, uint32_t net) {
+    while(aliases[net] != net) net = aliases[net];
+    return net;
+}
+
+static bool is_commutative(SimNetGate *gate) {
+    return gate->type != SIM_NET_GATE_LUT;
+}
+
+// sorts the inputs, so the same gate with its inputs in other order hashes the same
+static void sort_inputs(SimNetGate *gate) {
+    for(size_t i = 1; i < gate->inputCount; i++) {
+        uint32_t input = gate->inputs[i];
+        size_t j = i;
+        for(; j > 0 && gate->inputs[j - 1] > input; j--) {
+            gate->inputs[j] = gate->inputs[j - 1];
+        }
+        gate->inputs[j] = input;
+    }
+}
+
+static bool is_inverter(SimNetGate *gate) {
+    return gate->type == SIM_NET_GATE_NAND && gate->inputs[0] == gate->inputs[1];
+}
+
+// hash set of gates used to find gates with the same type and inputs
+typedef struct {
+    size_t *items; // gate index + 1, 0 means empty
+    size_t capacity;
+} GateTable;
+
+static size_t gate_hash(SimNetGate *gate) {
+    size_t hash = gate->type;
+    for(size_t i = 0; i < gate->inputCount; i++) {
+        hash = (hash ^ gate->inputs[i]) * 1099511628211llu;
+    }
+    return hash;
+}
+
+static bool gates_are_identical(SimNetGate *a, SimNetGate *b) {
+    if(a->type != b->type || a->inputCount != b->inputCount) return false;
+    return memcmp(a->inputs, b->inputs, a->inputCount*sizeof(uint32_t)) == 0;
+}
+
+// @return the index of an identical gate or SIZE_MAX when the gate is new
+static size_t gate_table_find_or_add(GateTable *table, SimNetGate *gates, size_t gateIndex) {
+    SimNetGate *gate = &gates[gateIndex];
+    size_t i = gate_hash(gate) & (table->capacity - 1);
+    while(table->items[i] != 0) {
+        size_t other = table->items[i] - 1;
+        if(gates_are_identical(gate, &gates[other])) return other;
+        i = (i + 1) & (table->capacity - 1);
+    }
+
+    table->items[i] = gateIndex + 1;
+    return SIZE_MAX;
+}
+
+// removes the inputs that don't change the result of a wide gate (HIGH in an AND,
+// LOW in the rest) and checks if any input decides it alone (LOW in an AND, HIGH in an OR)
+// @return true if the output of the gate is always the same or the same as an input
+static bool fold_wide_gate(SimNetGate *gate, uint32_t *replacement) {
+    bool isAnd = gate->type == SIM_NET_GATE_AND;
+    bool isOr = gate->type == SIM_NET_GATE_OR || gate->type == SIM_NET_GATE_NOR;
+    bool inverted = sim_net_gate_is_inverted(gate->type);
+    uint32_t identity = isAnd ? SIM_NET_HIGH : SIM_NET_LOW;
+
+    size_t count = 0;
+    for(size_t i = 0; i < gate->inputCount; i++) {
+        uint32_t input = gate->inputs[i];
+        if((isAnd && input == SIM_NET_LOW) || (isOr && input == SIM_NET_HIGH)) {
+            *replacement = (input == SIM_NET_HIGH) != inverted ? SIM_NET_HIGH : SIM_NET_LOW;
+            return true;
+        }
+        if(input != identity) gate->inputs[count++] = input;
+    }
+
+    if(count == 0) {
+        *replacement = (identity == SIM_NET_HIGH) != inverted ? SIM_NET_HIGH : SIM_NET_LOW;
+        return true;
+    }
+    gate->inputCount = count;
+
+    // a gate with a single input is a buffer, but the Z of a floating input becomes X
+    if(count == 1 && !inverted && gate->inputs[0] != SIM_NET_FLOATING) {
+        *replacement = gate->inputs[0];
+        return true;
+    }
+    // and the inverters are NANDs, so the rest of optimizations see them
+    if(count == 1 && inverted) {
+        uint32_t input = gate->inputs[0];
+        free(gate->inputs);
+        gate->inputs = alloc(2*sizeof(uint32_t));
+        gate->inputs[0] = gate->inputs[1] = input;
+        gate->inputCount = 2;
+        gate->type = SIM_NET_GATE_NAND;
+    }
+    return false;
+}
+
+// @return true if the output of the gate is always the same
+static bool fold_constant(SimNetGate *gate, uint32_t *replacement) {
+    if(gate->type == SIM_NET_GATE_LUT) return false;
+    if(gate->type != SIM_NET_GATE_NAND) return fold_wide_gate(gate, replacement);
+
+    uint32_t a = gate->inputs[0];
+    uint32_t b = gate->inputs[1];
+    if(a == SIM_NET_LOW || b == SIM_NET_LOW) {
+        *replacement = SIM_NET_HIGH;
+        return true;
+    }
+    if(a == SIM_NET_HIGH && b == SIM_NET_HIGH) {
+        *replacement = SIM_NET_LOW;
+        return true;
+    }
+
+    // a NAND with a high input is just an inverter of the other one
+    if(a == SIM_NET_HIGH) gate->inputs[0] = b;
+    if(b == SIM_NET_HIGH) gate->inputs[1] = a;
+    return false;
+}
+
+// @return true if the gate inverts the output of another inverter
+static bool remove_double_inversion(SimNetlist *netlist, SimNetGate *gate, size_t *drivers, bool *removed, uint32_t *replacement) {
+    if(!is_inverter(gate)) return false;
+
+    size_t driver = drivers[gate->inputs[0]];
+    if(driver == SIZE_MAX || removed[driver]) return false;
+
+    SimNetGate *inverter = &netlist->gates.items[driver];
+    if(!is_inverter(inverter) || inverter->feedback) return false;
+    // inverting Z twice gives X, not Z
+    if(inverter->inputs[0] == SIM_NET_FLOATING) return false;
+
+    *replacement = inverter->inputs[0];
+    return true;
+}
+
+// @return true if any gate was removed
+static bool simplify_pass(SimNetlist *netlist, uint32_t *aliases) {
+    size_t gateCount = netlist->gates.count;
+    size_t *drivers = sim_netlist_get_drivers(netlist);
+    bool *removed = alloc(gateCount*sizeof(bool));
+    bool changed = false;
+
+    GateTable table = { .capacity = 16 };
+    while(table.capacity < gateCount*2) table.capacity *= 2;
+    table.items = alloc(table.capacity*sizeof(size_t));
+
+    for(size_t i = 0; i < gateCount; i++) {
+        SimNetGate *gate = &netlist->gates.items[i];
+
+        for(size_t j = 0; j < gate->inputCount; j++) {
+            gate->inputs[j] = resolve_net(aliases, gate->inputs[j]);
+        }
+        uint32_t replacement;
+        bool redundant = fold_constant(gate, &replacement);
+        if(is_commutative(gate)) {
+            sort_inputs(gate);
+        }
+
+        // the gates inside a loop depend on their previous state, so only
+        // the constants are safe to fold
+        if(!redundant && !gate->feedback) {
+            redundant = remove_double_inversion(netlist, gate, drivers, removed, &replacement);
+        }
+        if(!redundant && !gate->feedback) {
+            size_t identical = gate_table_find_or_add(&table, netlist->gates.items, i);
+            if(identical != SIZE_MAX) {
+                replacement = netlist->gates.items[identical].output;
+                redundant = true;
+            }
+        }
+
+        if(redundant) {
+            aliases[gate->output] = replacement;
+            removed[i] = true;
+            changed = true;
+        }
+    }
+
+    if(changed) {
+        sim_netlist_remove_gates(netlist, removed);
+    }
+
+    free(table.items);
+    free(removed);
+    free(drivers);
+    return changed;
+}
+
+static void remove_dead_gates(SimNetlist *netlist) {
+    size_t gateCount = netlist->gates.count;
+    size_t *drivers = sim_netlist_get_drivers(netlist);
+    bool *live = alloc(gateCount*sizeof(bool));
+
+    // we walk backwards from the outputs marking every gate we find
+    struct {
+        uint32_t *items;
+        size_t count;
+        size_t capacity;
+    } stack = {0};
+    for(size_t i = 0; i < netlist->outputs.count; i++) {
+        da_append(&stack, netlist->outputs.items[i].net);
+    }
+    // the inputs of the sequential chips are outputs of the combinational part
+    for(size_t i = 0; i < netlist->sequential.count; i++) {
+        SimNetSequential *sequential = &netlist->sequential.items[i];
+        for(size_t j = 0; j < sequential->inputCount; j++) {
+            da_append(&stack, sequential->inputs[j]);
+        }
+    }
+
+    while(stack.count > 0) {
+        uint32_t net = stack.items[--stack.count];
+        size_t driver = drivers[net];
+        if(driver == SIZE_MAX || live[driver]) continue;
+        live[driver] = true;
+
+        SimNetGate *gate = &netlist->gates.items[driver];
+        for(size_t i = 0; i < gate->inputCount; i++) {
+            da_append(&stack, gate->inputs[i]);
+        }
+    }
+
+    bool *removed = alloc(gateCount*sizeof(bool));
+    for(size_t i = 0; i < gateCount; i++) {
+        removed[i] = !live[i];
+    }
+    sim_netlist_remove_gates(netlist, removed);
+
+    free(removed);
+    da_free(&stack);
+    free(live);
+    free(drivers);
+}
+
+void sim_netlist_optimize(SimNetlist *netlist) {
+    uint32_t *aliases = alloc(netlist->netCount*sizeof(uint32_t));
+    for(size_t i = 0; i < netlist->netCount; i++) {
+        aliases[i] = i;
+    }
+
+    // removing a gate can make others redundant, so we repeat until nothing changes
+    while(simplify_pass(netlist, aliases));
+
+    for(size_t i = 0; i < netlist->outputs.count; i++) {
+        SimNetPort *output = &netlist->outputs.items[i];
+        output->net = resolve_net(aliases, output->net);
+    }
+    for(size_t i = 0; i < netlist->pins.count; i++) {
+        SimNetPin *pin = &netlist->pins.items[i];
+        pin->net = resolve_net(aliases, pin->net);
+    }
+    for(size_t i = 0; i < netlist->sequential.count; i++) {
+        SimNetSequential *sequential = &netlist->sequential.items[i];
+        for(size_t j = 0; j < sequential->inputCount; j++) {
+            sequential->inputs[j] = resolve_net(aliases, sequential->inputs[j]);
+        }
+    }
+
+    remove_dead_gates(netlist);
+
+    free(aliases);
+}
+
+// -------------- //
+// LUT collapsing //
+// -------------- //
+
+// limits the size of a cone when it has a lot of gates that don't add new inputs (like inverters)
+#define LUT_MAX_GATES 64
+
+// the first 6 inputs change inside the same 64 bit word of the truth table
+static const uint64_t lutPatterns[6] = {
+    0xAAAAAAAAAAAAAAAAllu,
+    0xCCCCCCCCCCCCCCCCllu,
+    0xF0F0F0F0F0F0F0F0llu,
+    0xFF00FF00FF00FF00llu,
+    0xFFFF0000FFFF0000llu,
+    0xFFFFFFFF00000000llu,
+};
+
+typedef struct {
+    size_t gates[LUT_MAX_GATES];
+    size_t gateCount;
+    uint32_t leaves[SIM_LUT_MAX_INPUTS];
+    size_t leafCount;
+} LutCone;
+
+// number of times each net is read by a gate, SIZE_MAX when a chip reads it
+static size_t *get_fanouts(SimNetlist *netlist) {
+    size_t *fanouts = alloc(netlist->netCount*sizeof(size_t));
+
+    for(size_t i = 0; i < netlist->gates.count; i++) {
+        SimNetGate *gate = &netlist->gates.items[i];
+        for(size_t j = 0; j < gate->inputCount; j++) {
+            fanouts[gate->inputs[j]]++;
+        }
+    }
+
+    // the outputs are read by someone outside the netlist, so they can't be absorbed
+    for(size_t i = 0; i < netlist->outputs.count; i++) {
+        fanouts[netlist->outputs.items[i].net] = SIZE_MAX;
+    }
+    for(size_t i = 0; i < netlist->sequential.count; i++) {
+        SimNetSequential *sequential = &netlist->sequential.items[i];
+        for(size_t j = 0; j < sequential->inputCount; j++) {
+            fanouts[sequential->inputs[j]] = SIZE_MAX;
+        }
+    }
+
+    return fanouts;
+}
+
+static bool can_be_absorbed(SimNetGate *gate) {
+    return gate->type != SIM_NET_GATE_LUT && !gate->feedback;
+}
+
+// number of times the net is read by the gates of the cone
+static size_t cone_net_reads(SimNetlist *netlist, LutCone *cone, uint32_t net) {
+    size_t reads = 0;
+    for(size_t i = 0; i < cone->gateCount; i++) {
+        SimNetGate *gate = &netlist->gates.items[cone->gates[i]];
+        for(size_t j = 0; j < gate->inputCount; j++) {
+            if(gate->inputs[j] == net) reads++;
+        }
+    }
+    return reads;
+}
+
+static bool cone_has_leaf(LutCone *cone, uint32_t net) {
+    for(size_t i = 0; i < cone->leafCount; i++) {
+        if(cone->leaves[i] == net) return true;
+    }
+    return false;
+}
+
+// replaces the leaf with the gate that drives it
+// @return false if the cone would have too many inputs
+static bool cone_absorb(SimNetlist *netlist, LutCone *cone, size_t leafIndex, size_t gateIndex) {
+    SimNetGate *gate = &netlist->gates.items[gateIndex];
+    if(cone->gateCount == LUT_MAX_GATES) return false;
+
+    LutCone newCone = *cone;
+    newCone.leaves[leafIndex] = newCone.leaves[--newCone.leafCount];
+    for(size_t i = 0; i < gate->inputCount; i++) {
+        uint32_t input = gate->inputs[i];
+        if(cone_has_leaf(&newCone, input)) continue;
+        if(newCone.leafCount == SIM_LUT_MAX_INPUTS) return false;
+        newCone.leaves[newCone.leafCount++] = input;
+    }
+    newCone.gates[newCone.gateCount++] = gateIndex;
+
+    *cone = newCone;
+    return true;
+}
+
+static void cone_grow(SimNetlist *netlist, LutCone *cone, size_t *drivers, size_t *fanouts, bool *removed) {
+    bool grew = true;
+    while(grew) {
+        grew = false;
+        for(size_t i = 0; i < cone->leafCount; i++) {
+            uint32_t leaf = cone->leaves[i];
+            size_t driver = drivers[leaf];
+            if(driver == SIZE_MAX || removed[driver]) continue;
+            if(!can_be_absorbed(&netlist->gates.items[driver])) continue;
+            // if someone outside of the cone reads the net, the gate has to stay
+            if(fanouts[leaf] != cone_net_reads(netlist, cone, leaf)) continue;
+
+            if(cone_absorb(netlist, cone, i, driver)) {
+                grew = true;
+                break;
+            }
+        }
+    }
+}
+
+static uint64_t *cone_truth_table(SimNetlist *netlist, LutCone *cone, uint64_t *scratch) {
+    size_t combinations = 1llu << cone->leafCount;
+    size_t words = (combinations + 63) / 64;
+    uint64_t *table = alloc(words*sizeof(uint64_t));
+
+    SimNetGate *root = &netlist->gates.items[cone->gates[0]];
+    for(size_t word = 0; word < words; word++) {
+        for(size_t i = 0; i < cone->leafCount; i++) {
+            if(i < 6) {
+                scratch[cone->leaves[i]] = lutPatterns[i];
+            } else {
+                scratch[cone->leaves[i]] = (word >> (i - 6)) & 1 ? ~0llu : 0;
+            }
+        }
+
+        // every gate was added after the gates that read it, so we go backwards
+        for(size_t i = cone->gateCount; i > 0; i--) {
+            SimNetGate *gate = &netlist->gates.items[cone->gates[i - 1]];
+            scratch[gate->output] = sim_net_gate_eval(netlist, gate, scratch);
+        }
+
+        table[word] = scratch[root->output];
+    }
+
+    if(combinations < 64) {
+        table[0] &= (1llu << combinations) - 1;
+    }
+
+    return table;
+}
+
+// the truth table of "count" inputs, "words" is NULL when it fits in "word"
+typedef struct {
+    const uint64_t *words;
+    uint64_t word;
+    size_t count;
+} LutTable;
+
+typedef struct {
+    SimLutOp ops[SIM_LUT_MAX_OPS];
+    size_t count;
+    // the program is dropped when it gets longer than this
+    size_t max;
+    size_t inputCount;
+} LutProgram;
+
+// a part of the function while the program is built: a constant or an operand
+typedef struct {
+    bool constant;
+    bool high;
+    uint8_t operand;
+} LutValue;
+
+static uint64_t lut_word_mask(size_t count) {
+    return count >= 6 ? ~0llu : (1llu << (1llu << count)) - 1;
+}
+
+static size_t lut_word_count(LutTable table) {
+    return table.words == NULL ? 1 : (size_t)1 << (table.count - 6);
+}
+
+static uint64_t lut_word(LutTable table, size_t i) {
+    return table.words == NULL ? table.word : table.words[i];
+}
+
+// @return the half of the table where the last input is LOW, or HIGH when "high"
+static LutTable lut_half(LutTable table, bool high) {
+    if(table.words != NULL) {
+        const uint64_t *words = table.words + (high ? lut_word_count(table) / 2 : 0);
+        if(table.count == 7) return (LutTable){ .word = words[0], .count = 6 };
+        return (LutTable){ .words = words, .count = table.count - 1 };
+    }
+    uint64_t word = high ? table.word >> (1llu << (table.count - 1)) : table.word;
+    return (LutTable){ .word = word & lut_word_mask(table.count - 1), .count = table.count - 1 };
+}
+
+// @return true when "b" is the same as "a", or its inverse when "inverted"
+static bool lut_equal(LutTable a, LutTable b, bool inverted) {
+    uint64_t mask = lut_word_mask(a.count);
+    for(size_t i = 0; i < lut_word_count(a); i++) {
+        uint64_t word = inverted ? ~lut_word(b, i) & mask : lut_word(b, i);
+        if(lut_word(a, i) != word) return false;
+    }
+    return true;
+}
+
+static bool lut_is_constant(LutTable table, bool high) {
+    uint64_t word = high ? lut_word_mask(table.count) : 0;
+    for(size_t i = 0; i < lut_word_count(table); i++) {
+        if(lut_word(table, i) != word) return false;
+    }
+    return true;
+}
+
+// @return false when the program is already as long as it can be
+static bool lut_emit(LutProgram *program, SimLutOpType type, uint8_t a, uint8_t b, uint8_t c, LutValue *value) {
+    if(program->count == program->max) return false;
+    program->ops[program->count] = (SimLutOp){ .type = type, .a = a, .b = b, .c = c };
+    *value = (LutValue){ .operand = program->inputCount + program->count++ };
+    return true;
+}
+
+// "select" is LOW where the result is "low" and HIGH where it's "high", which are different
+static bool lut_select(LutProgram *program, uint8_t select, LutValue low, LutValue high, LutValue *value) {
+    if(low.constant && high.constant) {
+        if(high.high) {
+            *value = (LutValue){ .operand = select };
+            return true;
+        }
+        return lut_emit(program, SIM_LUT_OP_NOT, select, 0, 0, value);
+    }
+    if(low.constant) {
+        if(low.high) return lut_emit(program, SIM_LUT_OP_OR_NOT, high.operand, select, 0, value);
+        return lut_emit(program, SIM_LUT_OP_AND, select, high.operand, 0, value);
+    }
+    if(high.constant) {
+        if(high.high) return lut_emit(program, SIM_LUT_OP_OR, select, low.operand, 0, value);
+        return lut_emit(program, SIM_LUT_OP_AND_NOT, low.operand, select, 0, value);
+    }
+    return lut_emit(program, SIM_LUT_OP_MUX, select, low.operand, high.operand, value);
+}
+
+// splits the table by its last input until the halves are constant, the halves that are
+// the same or the inverse of each other only need one of them
+// @return false when the program would have more than "max" operations
+static bool lut_build(LutProgram *program, LutTable table, LutValue *value) {
+    for(size_t high = 0; high < 2; high++) {
+        if(lut_is_constant(table, high)) {
+            *value = (LutValue){ .constant = true, .high = high };
+            return true;
+        }
+    }
+
+    uint8_t select = table.count - 1;
+    LutTable lowTable = lut_half(table, false), highTable = lut_half(table, true);
+    LutValue low, high;
+    if(!lut_build(program, lowTable, &low)) return false;
+    if(lut_equal(lowTable, highTable, false)) {
+        *value = low;
+        return true;
+    }
+    if(lut_equal(lowTable, highTable, true)) {
+        if(low.constant) return lut_select(program, select, low, (LutValue){ .constant = true, .high = !low.high }, value);
+        return lut_emit(program, SIM_LUT_OP_XOR, select, low.operand, 0, value);
+    }
+    if(!lut_build(program, highTable, &high)) return false;
+    return lut_select(program, select, low, high, value);
+}
+
+// @return the program of the truth table, or NULL when it has more than "max" operations
+static SimLutOp *lut_program(uint64_t *table, size_t inputCount, size_t max, size_t *count) {
+    LutProgram program = { .max = max < SIM_LUT_MAX_OPS ? max : SIM_LUT_MAX_OPS, .inputCount = inputCount };
+    LutTable lutTable = { .words = inputCount > 6 ? table : NULL, .word = table[0], .count = inputCount };
+    LutValue value;
+    if(!lut_build(&program, lutTable, &value)) return NULL;
+
+    // the result has to be the last operation
+    bool ok = true;
+    if(value.constant) {
+        ok = lut_emit(&program, value.high ? SIM_LUT_OP_ONE : SIM_LUT_OP_ZERO, 0, 0, 0, &value);
+    } else if(value.operand != inputCount + program.count - 1) {
+        ok = lut_emit(&program, SIM_LUT_OP_COPY, value.operand, 0, 0, &value);
+    }
+    if(!ok) return NULL;
+
+    SimLutOp *ops = alloc(program.count*sizeof(SimLutOp));
+    memcpy(ops, program.ops, program.count*sizeof(SimLutOp));
+    *count = program.count;
+    return ops;
+}
+
+void sim_netlist_collapse_luts(SimNetlist *netlist) {
+    if(netlist->fourState) return;
+
+    size_t *drivers = sim_netlist_get_drivers(netlist);
+    size_t *fanouts = get_fanouts(netlist);
+    bool *removed = alloc(netlist->gates.count*sizeof(bool));
+    uint64_t *scratch = alloc(netlist->netCount*sizeof(uint64_t));
+
+    // the gates are levelized, so going backwards we start with the biggest cones
+    for(size_t i = netlist->gates.count; i > 0; i--) {
+        size_t gateIndex = i - 1;
+        SimNetGate *gate = &netlist->gates.items[gateIndex];
+        if(removed[gateIndex] || !can_be_absorbed(gate)) continue;
+        if(gate->inputCount > SIM_LUT_MAX_INPUTS) continue;
+
+        LutCone cone = { .gates = { gateIndex } , .gateCount = 1 };
+        for(size_t j = 0; j < gate->inputCount; j++) {
+            if(!cone_has_leaf(&cone, gate->inputs[j])) {
+                cone.leaves[cone.leafCount++] = gate->inputs[j];
+            }
+        }
+
+        cone_grow(netlist, &cone, drivers, fanouts, removed);
+        // a single gate is cheaper than a LUT
+        if(cone.gateCount < 2) continue;
+
+        // with many lanes the LUT runs its program, so it's only made when the program
+        // isn't longer than the gates it replaces
+        uint64_t *table = cone_truth_table(netlist, &cone, scratch);
+        size_t programCount;
+        SimLutOp *program = lut_program(table, cone.leafCount, cone.gateCount, &programCount);
+        if(program == NULL) {
+            free(table);
+            continue;
+        }
+        for(size_t j = 1; j < cone.gateCount; j++) {
+            removed[cone.gates[j]] = true;
+        }
+
+        free(gate->inputs);
+        gate->type = SIM_NET_GATE_LUT;
+        gate->inputCount = cone.leafCount;
+        gate->inputs = alloc(cone.leafCount*sizeof(uint32_t));
+        memcpy(gate->inputs, cone.leaves, cone.leafCount*sizeof(uint32_t));
+        gate->table = table;
+        gate->program = program;
+        gate->programCount = programCount;
+    }
+
+    sim_netlist_remove_gates(netlist, removed);
+
+    free(scratch);
+    free(removed);
+    free(fanouts);
+    free(drivers);
+}
@@ -0,0 +1,36 @@
+#ifndef SIMULATION_OPTIMIZE_H
+#define SIMULATION_OPTIMIZE_H
+
+#include "simulation_netlist.h"
+
+/*
+ * Simplifies the netlist without changing what the outputs see:
+ *  - Gates with constant inputs are folded into a constant.
+ *  - Two inverters in a row are replaced by the net before them.
+ *  - Gates with the same type and inputs are merged into one.
+ *  - Gates whose output never reaches a SIM_CHIP_OUTPUT are removed.
+ *
+ * The pins of the removed gates keep pointing to a net with the same value,
+ * except the ones of dead gates which aren't updated anymore.
+ */
+void sim_netlist_optimize(SimNetlist *netlist);
+
+/*
+ * Finds combinational cones with at most SIM_LUT_MAX_INPUTS inputs and replaces
+ * each one with a single LUT gate. The truth table of the LUT is calculated
+ * simulating every input combination of the cone.
+ *
+ * Only gates whose output is read exclusively inside the cone are absorbed,
+ * so the rest of the netlist doesn't notice the change.
+ *
+ * Every LUT also gets a program of word-wide operations that evaluates all the lanes
+ * at once, and a cone is only collapsed when that program isn't longer than the
+ * gates it replaces.
+ *
+ * Does nothing with four-state logic: a cone propagates X gate by gate (NAND(X, LOW)
+ * is HIGH) and a truth table of LOW and HIGH can't reproduce that, so collapsing it
+ * would change the results.
+ */
+void sim_netlist_collapse_luts(SimNetlist *netlist);
+
+#endif // SIMULATION_OPTIMIZE_H
@@ -0,0 +1,140 @@
+#include <string.h>
+
+#include "simulation_snapshot.h"
+
+static size_t get_entry_count(SimContext *context) {
+    size_t count = 0;
+    for(SetItem *item = context->chips->head; item != NULL; item = item->next) {
+        SimChip *chip = item->data;
+        count += chip->inputs.count + chip->outputs.count;
+        if(chip->stored != NULL) count += chip->outputs.count;
+    }
+    return count;
+}
+
+// the fields are copied one by one, so the padding of the entries stays zeroed
+// and two pages can be compared with memcmp
+static SimSnapshotEntry *save_pin_array(SimPinArray *pins, SimSnapshotEntry *entry) {
+    for(size_t i = 0; i < pins->count; i++, entry++) {
+        entry->state = pins->items[i].state;
+        entry->bits = pins->items[i].bits;
+    }
+    return entry;
+}
+
+static SimSnapshotEntry *load_pin_array(SimPinArray *pins, SimSnapshotEntry *entry) {
+    for(size_t i = 0; i < pins->count; i++, entry++) {
+        pins->items[i].state = entry->state;
+        pins->items[i].bits = entry->bits;
+    }
+    return entry;
+}
+
+static void save_state(SimContext *context, SimSnapshotEntry *entry) {
+    for(SetItem *item = context->chips->head; item != NULL; item = item->next) {
+        SimChip *chip = item->data;
+        entry = save_pin_array(&chip->inputs, entry);
+        entry = save_pin_array(&chip->outputs, entry);
+        if(chip->stored == NULL) continue;
+        for(size_t i = 0; i < chip->outputs.count; i++, entry++) {
+            entry->state = chip->stored[i];
+        }
+    }
+}
+
+static void load_state(SimContext *context, SimSnapshotEntry *entry) {
+    for(SetItem *item = context->chips->head; item != NULL; item = item->next) {
+        SimChip *chip = item->data;
+        entry = load_pin_array(&chip->inputs, entry);
+        entry = load_pin_array(&chip->outputs, entry);
+        if(chip->stored == NULL) continue;
+        for(size_t i = 0; i < chip->outputs.count; i++, entry++) {
+            chip->stored[i] = entry->state;
+        }
+    }
+}
+
+static SimSnapshot *snapshot_new(size_t topology, size_t entryCount) {
+    SimSnapshot *snapshot = alloc(sizeof(SimSnapshot));
+    snapshot->topology = topology;
+    snapshot->entryCount = entryCount;
+    snapshot->pageCount = (entryCount + SIM_SNAPSHOT_PAGE_SIZE - 1) / SIM_SNAPSHOT_PAGE_SIZE;
+    snapshot->pages = alloc(snapshot->pageCount*sizeof(SimSnapshotPage *));
+    snapshot->bytes = sizeof(SimSnapshot) + snapshot->pageCount*sizeof(SimSnapshotPage *);
+    return snapshot;
+}
+
+// the copy shares all the pages
+static SimSnapshot *snapshot_copy(SimSnapshot *snapshot) {
+    SimSnapshot *copy = snapshot_new(snapshot->topology, snapshot->entryCount);
+    for(size_t i = 0; i < snapshot->pageCount; i++) {
+        copy->pages[i] = snapshot->pages[i];
+        copy->pages[i]->refs++;
+    }
+    return copy;
+}
+
+static void set_shadow(SimContext *context, SimSnapshot *snapshot) {
+    if(context->shadow != NULL) sim_snapshot_free(context->shadow);
+    context->shadow = snapshot_copy(snapshot);
+}
+
+SimSnapshot *sim_snapshot(SimContext *context) {
+    size_t entryCount = get_entry_count(context);
+    SimSnapshot *snapshot = snapshot_new(context->topology, entryCount);
+
+    // a whole page is allocated so the last one can be compared with memcmp too
+    size_t bufferSize = snapshot->pageCount*SIM_SNAPSHOT_PAGE_SIZE;
+    SimSnapshotEntry *entries = alloc((bufferSize > 0 ? bufferSize : 1)*sizeof(SimSnapshotEntry));
+    save_state(context, entries);
+
+    // the pages of the shadow can only be shared if the state has the same layout
+    SimSnapshot *shadow = context->shadow;
+    bool canShare = shadow != NULL && shadow->topology == snapshot->topology && shadow->entryCount == entryCount;
+
+    for(size_t i = 0; i < snapshot->pageCount; i++) {
+        SimSnapshotEntry *pageEntries = &entries[i*SIM_SNAPSHOT_PAGE_SIZE];
+        if(canShare && memcmp(shadow->pages[i]->entries, pageEntries, sizeof(shadow->pages[i]->entries)) == 0) {
+            snapshot->pages[i] = shadow->pages[i];
+            snapshot->pages[i]->refs++;
+            continue;
+        }
+
+        SimSnapshotPage *page = alloc(sizeof(SimSnapshotPage));
+        memcpy(page->entries, pageEntries, sizeof(page->entries));
+        page->refs = 1;
+        snapshot->pages[i] = page;
+        snapshot->bytes += sizeof(SimSnapshotPage);
+    }
+
+    free(entries);
+    set_shadow(context, snapshot);
+    return snapshot;
+}
+
+bool sim_restore(SimContext *context, SimSnapshot *snapshot) {
+    if(snapshot->topology != context->topology) {
+        printf("[ERROR] The chips or the connections changed since the snapshot was taken\n");
+        return false;
+    }
+
+    size_t bufferSize = snapshot->pageCount*SIM_SNAPSHOT_PAGE_SIZE;
+    SimSnapshotEntry *entries = alloc((bufferSize > 0 ? bufferSize : 1)*sizeof(SimSnapshotEntry));
+    for(size_t i = 0; i < snapshot->pageCount; i++) {
+        memcpy(&entries[i*SIM_SNAPSHOT_PAGE_SIZE], snapshot->pages[i]->entries, sizeof(snapshot->pages[i]->entries));
+    }
+    load_state(context, entries);
+    free(entries);
+
+    set_shadow(context, snapshot);
+    return true;
+}
+
+void sim_snapshot_free(SimSnapshot *snapshot) {
+    for(size_t i = 0; i < snapshot->pageCount; i++) {
+        SimSnapshotPage *page = snapshot->pages[i];
+        if(--page->refs == 0) free(page);
+    }
+    free(snapshot->pages);
+    free(snapshot);
+}
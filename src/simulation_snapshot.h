@@ -0,0 +1,55 @@
+#ifndef SIMULATION_SNAPSHOT_H
+#define SIMULATION_SNAPSHOT_H
+
+#include "simulation.h"
+
+/*
+ * A snapshot is a copy of the state of every pin and every value stored by
+ * the sequential chips, taken in the order of the chips of the context.
+ *
+ * The state is split in pages of SIM_SNAPSHOT_PAGE_SIZE entries that are
+ * shared between snapshots: the context keeps a reference to the pages
+ * of the last snapshot (or the last restored one) and a new snapshot only
+ * copies the pages that changed since then. Between two clock ticks most of
+ * the circuit stays the same, so thousands of snapshots are cheap.
+ *
+ * A snapshot can only be restored while the chips and connections are the
+ * same they were when it was taken (see SimContext.topology).
+ */
+
+#define SIM_SNAPSHOT_PAGE_SIZE 256
+
+// state of a pin or a value stored by a sequential chip
+typedef struct {
+    SimPinState state;
+    SimLogic bits;
+} SimSnapshotEntry;
+
+typedef struct {
+    // number of snapshots that use the page
+    size_t refs;
+    SimSnapshotEntry entries[SIM_SNAPSHOT_PAGE_SIZE];
+} SimSnapshotPage;
+
+struct SimSnapshot {
+    size_t topology;
+    size_t entryCount;
+    SimSnapshotPage **pages;
+    size_t pageCount;
+    // memory allocated for the snapshot, the pages shared with the last snapshot aren't counted
+    size_t bytes;
+};
+
+SimSnapshot *sim_snapshot(SimContext *context);
+
+/*
+ * Puts every pin back in the state it had when the snapshot was taken,
+ * nothing is propagated since the saved states were already settled.
+ *
+ * @return false when the chips or the connections changed since then
+ */
+bool sim_restore(SimContext *context, SimSnapshot *snapshot);
+
+void sim_snapshot_free(SimSnapshot *snapshot);
+
+#endif // SIMULATION_SNAPSHOT_H
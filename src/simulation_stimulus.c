@@ -0,0 +1,125 @@
+#include <string.h>
+
+#include "simulation_stimulus.h"
+
+typedef struct {
+    char **items;
+    size_t count;
+    size_t capacity;
+} VectorArray;
+
+typedef struct {
+    SimStimulusSet *items;
+    size_t count;
+    size_t capacity;
+} SetArray;
+
+size_t sim_stimulus_count_chips(SimContext *context, SimChipType type) {
+    size_t count = 0;
+    for(SetItem *item = context->chips->head; item != NULL; item = item->next) {
+        SimChip *chip = item->data;
+        if(chip->type == type) count++;
+    }
+    return count;
+}
+
+static char *read_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if(file == NULL) {
+        printf("[ERROR] Couldn't open %s\n", path);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *content = alloc(size + 1);
+    if(fread(content, 1, size, file) != (size_t)size) {
+        printf("[ERROR] Couldn't read %s\n", path);
+        free(content);
+        content = NULL;
+    }
+
+    fclose(file);
+    return content;
+}
+
+static void end_set(SetArray *sets, SimStimulusSet set) {
+    if(set.count > 0) da_append(sets, set);
+}
+
+// splits the content in lines and sets, the lines are ended in place
+static bool parse_stimulus(char *content, const char *path, size_t inputCount, VectorArray *vectors, SetArray *sets) {
+    SimStimulusSet set = {0};
+    size_t lineNumber = 0;
+
+    char *line = content;
+    while(line != NULL && *line != '\0') {
+        lineNumber++;
+        char *end = strchr(line, '\n');
+        char *next = end != NULL ? end + 1 : NULL;
+        if(end == NULL) end = line + strlen(line);
+        if(end > line && end[-1] == '\r') end--;
+        *end = '\0';
+
+        if(line[0] == '#') {
+            line = next;
+            continue;
+        }
+
+        size_t length = end - line;
+        if(length == 0) {
+            end_set(sets, set);
+            set = (SimStimulusSet){ .first = vectors->count };
+            line = next;
+            continue;
+        }
+
+        if(length != inputCount) {
+            printf("[ERROR] Line %zu of %s has %zu values but the circuit has %zu inputs\n", lineNumber, path, length, inputCount);
+            return false;
+        }
+        if(strspn(line, "01") != length) {
+            printf("[ERROR] Line %zu of %s has a value that is not 0 or 1\n", lineNumber, path);
+            return false;
+        }
+
+        da_append(vectors, line);
+        set.count++;
+        line = next;
+    }
+    end_set(sets, set);
+
+    return true;
+}
+
+SimStimulus *sim_stimulus_load(const char *path, size_t inputCount) {
+    char *content = read_file(path);
+    if(content == NULL) return NULL;
+
+    VectorArray vectors = {0};
+    SetArray sets = {0};
+    if(!parse_stimulus(content, path, inputCount, &vectors, &sets)) {
+        da_free(&vectors);
+        da_free(&sets);
+        free(content);
+        return NULL;
+    }
+
+    SimStimulus *stimulus = alloc(sizeof(SimStimulus));
+    stimulus->vectors = vectors.items;
+    stimulus->vectorCount = vectors.count;
+    stimulus->sets = sets.items;
+    stimulus->setCount = sets.count;
+    stimulus->inputCount = inputCount;
+    stimulus->content = content;
+    return stimulus;
+}
+
+void sim_stimulus_free(SimStimulus *stimulus) {
+    free(stimulus->vectors);
+    free(stimulus->sets);
+    free(stimulus->content);
+    free(stimulus);
+}
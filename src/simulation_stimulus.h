@@ -0,0 +1,50 @@
+#ifndef SIMULATION_STIMULUS_H
+#define SIMULATION_STIMULUS_H
+
+#include "simulation.h"
+
+/*
+ * A stimulus is a text file with one vector per line: a '0' or '1' for
+ * each input chip, in the order the inputs were added. A blank line ends a
+ * vector set, the sets are independent of each other and every one starts
+ * from the same state. Lines starting with '#' are comments.
+ *
+ *   # two sets of a circuit with three inputs
+ *   010
+ *   011
+ *
+ *   110
+ */
+
+typedef struct {
+    // index of the first vector of the set
+    size_t first;
+    size_t count;
+} SimStimulusSet;
+
+typedef struct {
+    // the lines of the file, a character for each input
+    char **vectors;
+    size_t vectorCount;
+    SimStimulusSet *sets;
+    size_t setCount;
+    size_t inputCount;
+
+    // the vectors point inside it
+    char *content;
+} SimStimulus;
+
+/*
+ * @return NULL when the file can't be read or a vector doesn't have "inputCount" values
+ */
+SimStimulus *sim_stimulus_load(const char *path, size_t inputCount);
+
+void sim_stimulus_free(SimStimulus *stimulus);
+
+/*
+ * @return the number of chips of the type in the context, used to know how many
+ * values the vectors and the results have
+ */
+size_t sim_stimulus_count_chips(SimContext *context, SimChipType type);
+
+#endif // SIMULATION_STIMULUS_H
@@ -0,0 +1,166 @@
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "simulation_sweep.h"
+#include "simulation_netlist.h"
+#include "simulation_stimulus.h"
+
+typedef struct {
+    SimStimulus *stimulus;
+    size_t outputCount;
+    SimSweepOptions options;
+
+    // a line for every vector, each set writes only its own part
+    char *results;
+    // where the results of each set start in the results buffer
+    size_t *resultOffsets;
+
+    size_t batchCount;
+    // the workers take the batches in order until there are none left
+    atomic_size_t nextBatch;
+} Sweep;
+
+typedef struct {
+    Sweep *sweep;
+    SimContext *clone;
+    pthread_t thread;
+} SweepWorker;
+
+static void write_outputs(Sweep *sweep, SimNetlist *netlist, size_t set, size_t step, size_t lane) {
+    char *result = &sweep->results[sweep->resultOffsets[set] + step*(sweep->outputCount + 1)];
+    for(size_t i = 0; i < sweep->outputCount; i++) {
+        if((sim_netlist_get_output_unknown(netlist, i) >> lane) & 1) {
+            result[i] = 'X';
+        } else {
+            result[i] = (sim_netlist_get_output(netlist, i) >> lane) & 1 ? '1' : '0';
+        }
+    }
+    result[sweep->outputCount] = '\n';
+}
+
+// every set of the batch runs in its own lane
+static void run_batch(Sweep *sweep, SimNetlist *netlist, size_t batch) {
+    size_t firstSet = batch*SIM_SWEEP_BATCH_SIZE;
+    SimStimulusSet *sets = &sweep->stimulus->sets[firstSet];
+    size_t setCount = sweep->stimulus->setCount - firstSet;
+    if(setCount > SIM_SWEEP_BATCH_SIZE) setCount = SIM_SWEEP_BATCH_SIZE;
+    netlist->lanes = setCount;
+
+    size_t steps = 0;
+    for(size_t lane = 0; lane < setCount; lane++) {
+        if(sets[lane].count > steps) steps = sets[lane].count;
+    }
+
+    for(size_t step = 0; step < steps; step++) {
+        // the lanes of the sets that already ended keep running, but nobody reads them
+        for(size_t i = 0; i < sweep->stimulus->inputCount; i++) {
+            uint64_t value = 0;
+            for(size_t lane = 0; lane < setCount; lane++) {
+                if(step >= sets[lane].count) continue;
+                char *vector = sweep->stimulus->vectors[sets[lane].first + step];
+                value |= (uint64_t)(vector[i] == '1') << lane;
+            }
+            sim_netlist_set_input(netlist, i, value);
+        }
+
+        sim_netlist_eval(netlist);
+        sim_netlist_run_cycles(netlist, sweep->options.cyclesPerVector, NULL, NULL);
+
+        for(size_t lane = 0; lane < setCount; lane++) {
+            if(step < sets[lane].count) write_outputs(sweep, netlist, firstSet + lane, step, lane);
+        }
+    }
+}
+
+static void *sweep_worker(void *data) {
+    SweepWorker *worker = data;
+    Sweep *sweep = worker->sweep;
+
+    // four-state logic so the results show X like the chips do
+    SimNetlist *netlist = sim_netlist_compile(worker->clone->chips, (SimNetlistOptions){
+        .fourState = true,
+        .optimize = true,
+        .backend = SIM_BACKEND_VM,
+    });
+    assert(netlist->inputs.count == sweep->stimulus->inputCount && netlist->outputs.count == sweep->outputCount);
+
+    // every batch starts from the state the netlist has after compiling
+    SimNetlistState initial = sim_netlist_save_state(netlist);
+
+    for(;;) {
+        size_t batch = atomic_fetch_add(&sweep->nextBatch, 1);
+        if(batch >= sweep->batchCount) break;
+
+        sim_netlist_load_state(netlist, &initial);
+        run_batch(sweep, netlist, batch);
+    }
+
+    sim_netlist_state_free(&initial);
+    sim_netlist_free(netlist);
+    return NULL;
+}
+
+static bool write_results(Sweep *sweep, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if(file == NULL) {
+        printf("[ERROR] Couldn't open %s\n", path);
+        return false;
+    }
+
+    for(size_t i = 0; i < sweep->stimulus->setCount; i++) {
+        SimStimulusSet *set = &sweep->stimulus->sets[i];
+        fwrite(&sweep->results[sweep->resultOffsets[i]], 1, set->count*(sweep->outputCount + 1), file);
+        fputc('\n', file);
+    }
+
+    fclose(file);
+    return true;
+}
+
+bool sim_sweep_run(SimContext *context, const char *stimulusPath, const char *resultsPath, SimSweepOptions options) {
+    SimStimulus *stimulus = sim_stimulus_load(stimulusPath, sim_stimulus_count_chips(context, SIM_CHIP_INPUT));
+    if(stimulus == NULL) return false;
+
+    Sweep sweep = {
+        .stimulus = stimulus,
+        .outputCount = sim_stimulus_count_chips(context, SIM_CHIP_OUTPUT),
+        .options = options,
+    };
+
+    if(stimulus->setCount > 0) {
+        sweep.resultOffsets = alloc(stimulus->setCount*sizeof(size_t));
+        size_t resultsSize = 0;
+        for(size_t i = 0; i < stimulus->setCount; i++) {
+            sweep.resultOffsets[i] = resultsSize;
+            resultsSize += stimulus->sets[i].count*(sweep.outputCount + 1);
+        }
+        sweep.results = alloc(resultsSize);
+        sweep.batchCount = (stimulus->setCount + SIM_SWEEP_BATCH_SIZE - 1) / SIM_SWEEP_BATCH_SIZE;
+        atomic_init(&sweep.nextBatch, 0);
+
+        size_t threads = options.threads;
+        if(threads == 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if(threads > sweep.batchCount) threads = sweep.batchCount;
+
+        // the clones are made before any thread starts, so the context is only read here
+        SweepWorker *workers = alloc(threads*sizeof(SweepWorker));
+        for(size_t i = 0; i < threads; i++) {
+            workers[i].sweep = &sweep;
+            workers[i].clone = sim_context_clone(context);
+            pthread_create(&workers[i].thread, NULL, sweep_worker, &workers[i]);
+        }
+        for(size_t i = 0; i < threads; i++) {
+            pthread_join(workers[i].thread, NULL);
+            sim_context_free_chips(workers[i].clone);
+        }
+        free(workers);
+    }
+
+    bool ok = write_results(&sweep, resultsPath);
+    free(sweep.results);
+    free(sweep.resultOffsets);
+    sim_stimulus_free(stimulus);
+    return ok;
+}
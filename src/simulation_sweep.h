@@ -0,0 +1,37 @@
+#ifndef SIMULATION_SWEEP_H
+#define SIMULATION_SWEEP_H
+
+#include "simulation.h"
+
+/*
+ * Runs a stimulus file over a circuit using several threads.
+ *
+ * The stimulus has the format described in simulation_stimulus.h, every
+ * set starts from the state the circuit had when the sweep started.
+ *
+ * After applying a vector the circuit settles, runs "cyclesPerVector"
+ * clock cycles and then the outputs are read. The results have the same
+ * layout as the stimulus: one line per vector with a '0', '1' or 'X' for
+ * each output chip and a blank line after every set, in the same order as
+ * the stimulus no matter which thread ran each set.
+ *
+ * Every thread simulates its own clone of the context (see sim_context_clone)
+ * compiled to a netlist, and runs SIM_SWEEP_BATCH_SIZE sets at once, one
+ * in each lane of the nets.
+ */
+
+#define SIM_SWEEP_BATCH_SIZE 64
+
+typedef struct {
+    // worker threads, 0 uses one for each processor
+    size_t threads;
+    // clock cycles run after applying each vector, before reading the outputs
+    size_t cyclesPerVector;
+} SimSweepOptions;
+
+/*
+ * @return false when a file can't be opened or the stimulus is invalid
+ */
+bool sim_sweep_run(SimContext *context, const char *stimulusPath, const char *resultsPath, SimSweepOptions options);
+
+#endif // SIMULATION_SWEEP_H
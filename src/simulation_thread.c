@@ -0,0 +1,518 @@
+#include <string.h>
+#include <time.h>
+
+#include "simulation_thread.h"
+#include "simulation_netlist.h"
+
+// set in "middle" when the published buffer is newer than the one being read
+#define SIM_THREAD_FRESH ((size_t)1 << 2)
+
+static double get_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec*1e-9;
+}
+
+// @return the snapshot "index" counting from the oldest one
+static SimSnapshot **history_at(SimHistory *history, size_t index) {
+    return &history->items[(history->first + index) % SIM_THREAD_HISTORY_SIZE];
+}
+
+static void history_clear(SimHistory *history) {
+    for(size_t i = 0; i < history->count; i++) {
+        sim_snapshot_free(*history_at(history, i));
+    }
+    history->first = 0;
+    history->count = 0;
+    history->cursor = 0;
+    history->bytes = 0;
+}
+
+static void history_drop_oldest(SimHistory *history) {
+    SimSnapshot *oldest = *history_at(history, 0);
+    history->bytes -= oldest->bytes;
+    sim_snapshot_free(oldest);
+    history->first = (history->first + 1) % SIM_THREAD_HISTORY_SIZE;
+    history->count--;
+    if(history->cursor > 0) history->cursor--;
+}
+
+static void history_drop_newest(SimHistory *history) {
+    SimSnapshot *newest = *history_at(history, --history->count);
+    history->bytes -= newest->bytes;
+    sim_snapshot_free(newest);
+}
+
+// the snapshots can't be restored after the circuit is edited
+static bool history_is_stale(SimThread *thread) {
+    SimHistory *history = &thread->history;
+    return history->count > 0 && (*history_at(history, 0))->topology != thread->context->topology;
+}
+
+static void history_record(SimThread *thread) {
+    SimHistory *history = &thread->history;
+    if(history->items == NULL) {
+        history->items = alloc(SIM_THREAD_HISTORY_SIZE*sizeof(SimSnapshot *));
+    }
+    if(history_is_stale(thread)) history_clear(history);
+
+    // going back and changing something starts a new timeline
+    while(history->count > history->cursor + 1) {
+        history_drop_newest(history);
+    }
+
+    // when it's full the new snapshot takes the place of the oldest one
+    if(history->count == SIM_THREAD_HISTORY_SIZE) history_drop_oldest(history);
+
+    SimSnapshot *snapshot = sim_snapshot(thread->context);
+    *history_at(history, history->count++) = snapshot;
+    history->bytes += snapshot->bytes;
+    // the new snapshot is always kept, even if it doesn't fit on its own
+    while(history->bytes > SIM_THREAD_HISTORY_MAX_BYTES && history->count > 1) {
+        history_drop_oldest(history);
+    }
+    history->cursor = history->count - 1;
+    history->ticks = 0;
+    history->time = get_time();
+}
+
+// the state before the first change is recorded too, to be able to go back to it
+static void history_record_start(SimThread *thread) {
+    if(thread->history.count == 0 || history_is_stale(thread)) history_record(thread);
+}
+
+// @return true when the next call to history_record_tick records a snapshot
+static bool history_tick_is_due(SimHistory *history) {
+    return history->ticks + 1 >= SIM_THREAD_HISTORY_INTERVAL && get_time() - history->time >= SIM_THREAD_HISTORY_MIN_PERIOD;
+}
+
+// called after every tick of a long run, only some of them are recorded: the snapshots
+// are SIM_THREAD_HISTORY_INTERVAL ticks and SIM_THREAD_HISTORY_MIN_PERIOD seconds apart
+static void history_record_tick(SimThread *thread) {
+    bool due = history_tick_is_due(&thread->history);
+    thread->history.ticks++;
+    if(due) history_record(thread);
+}
+
+static void scrub(SimThread *thread, long steps) {
+    SimHistory *history = &thread->history;
+    if(history->count == 0) return;
+
+    long cursor = (long)history->cursor + steps;
+    if(cursor < 0) cursor = 0;
+    if(cursor >= (long)history->count) cursor = history->count - 1;
+
+    if(!sim_restore(thread->context, *history_at(history, cursor))) {
+        printf("[WARNING] The circuit changed, the history was cleared\n");
+        history_clear(history);
+        return;
+    }
+    history->cursor = cursor;
+    printf("[INFO] History %zu/%zu\n", history->cursor + 1, history->count);
+}
+
+static SimPinState get_output_state(SimNetlist *netlist, size_t index) {
+    if(sim_netlist_get_output_unknown(netlist, index) & 1) return PIN_X;
+    return sim_netlist_get_output(netlist, index) & 1;
+}
+
+typedef struct {
+    SimThread *thread;
+    // state of the outputs before the fast-forward, NULL when it doesn't stop when they change
+    SimPinState *initial;
+} FastForward;
+
+// records the history and stops the fast-forward when any output changes, if it was asked to
+static bool fast_forward_watch(SimNetlist *netlist, void *data) {
+    FastForward *fastForward = data;
+    SimThread *thread = fastForward->thread;
+    if(history_tick_is_due(&thread->history)) {
+        // the snapshots are taken from the pins
+        sim_netlist_write_back(netlist);
+    }
+    history_record_tick(thread);
+
+    if(fastForward->initial == NULL) return false;
+    for(size_t i = 0; i < netlist->outputs.count; i++) {
+        if(get_output_state(netlist, i) != fastForward->initial[i]) return true;
+    }
+    return false;
+}
+
+static void fast_forward(SimThread *thread, size_t cycles, bool untilChange) {
+    // the optimizations remove gates whose pins wouldn't be updated by the
+    // write back, so the chips could be left with old states
+    SimNetlist *netlist = sim_netlist_compile(thread->context->chips, (SimNetlistOptions){
+        .fourState = true,
+        .backend = SIM_BACKEND_VM,
+    });
+    if(netlist->clocks.count == 0) {
+        printf("[WARNING] There are no clocks to run\n");
+        sim_netlist_free(netlist);
+        return;
+    }
+
+    history_record_start(thread);
+
+    FastForward fastForward = { .thread = thread };
+    if(untilChange) {
+        fastForward.initial = alloc(netlist->outputs.count*sizeof(SimPinState));
+        for(size_t i = 0; i < netlist->outputs.count; i++) {
+            fastForward.initial[i] = get_output_state(netlist, i);
+        }
+    }
+
+    double start = get_time();
+    size_t ran = sim_netlist_run_cycles(netlist, cycles, fast_forward_watch, &fastForward);
+    printf("[INFO] Ran %zu cycles in %.3fs\n", ran, get_time() - start);
+
+    sim_netlist_write_back(netlist);
+    free(fastForward.initial);
+    sim_netlist_free(netlist);
+
+    history_record(thread);
+}
+
+struct SimJobRun {
+    SimJob job;
+    SimContext *context;
+    Set *chips;
+    void *data;
+    pthread_t thread;
+    atomic_bool done;
+};
+
+static void job_run_free(SimJobRun *run) {
+    sim_context_free_chips(run->context);
+    if(run->chips != NULL) set_clear_and_destroy(run->chips);
+    free(run);
+}
+
+static void *job_thread(void *data) {
+    SimJobRun *run = data;
+    run->job(run->context, run->chips, run->data);
+    atomic_store(&run->done, true);
+    return NULL;
+}
+
+// joins the jobs that ended, or all of them when "wait" is true
+static void join_jobs(SimJobRunArray *jobs, bool wait) {
+    size_t kept = 0;
+    for(size_t i = 0; i < jobs->count; i++) {
+        SimJobRun *run = jobs->items[i];
+        if(!wait && !atomic_load(&run->done)) {
+            jobs->items[kept++] = run;
+            continue;
+        }
+        pthread_join(run->thread, NULL);
+        job_run_free(run);
+    }
+    jobs->count = kept;
+}
+
+static bool job_is_running(SimJobRunArray *jobs, SimJob job) {
+    for(size_t i = 0; i < jobs->count; i++) {
+        if(jobs->items[i]->job == job && !atomic_load(&jobs->items[i]->done)) return true;
+    }
+    return false;
+}
+
+// the clone has the chips in the same order as the context, so the chips of the
+// command are found walking both at the same time
+static Set *clone_selection(SimContext *context, SimContext *clone, Set *chips) {
+    Map *selected = map_new();
+    for(SetItem *item = chips->head; item != NULL; item = item->next) {
+        map_set(selected, item->data, 0);
+    }
+
+    Set *clones = set_new();
+    SetItem *copy = clone->chips->head;
+    for(SetItem *item = context->chips->head; item != NULL; item = item->next) {
+        size_t unused;
+        if(map_get(selected, item->data, &unused)) set_add(clones, copy->data);
+        copy = copy->next;
+    }
+    map_free(selected);
+    return clones;
+}
+
+static void start_job(SimThread *thread, SimCommand *command) {
+    join_jobs(&thread->jobs, false);
+    // the jobs write their results to fixed files, two at once would mix them
+    if(job_is_running(&thread->jobs, command->job)) {
+        printf("[WARNING] The job is still running, wait until it ends to start it again\n");
+        if(command->chips != NULL) set_clear_and_destroy(command->chips);
+        return;
+    }
+
+    SimJobRun *run = alloc(sizeof(SimJobRun));
+    run->job = command->job;
+    run->context = sim_context_clone(thread->context);
+    run->data = command->data;
+    atomic_init(&run->done, false);
+    if(command->chips != NULL) {
+        run->chips = clone_selection(thread->context, run->context, command->chips);
+        set_clear_and_destroy(command->chips);
+    }
+
+    int error = pthread_create(&run->thread, NULL, job_thread, run);
+    if(error != 0) {
+        printf("[ERROR] Couldn't start the job: %s\n", strerror(error));
+        job_run_free(run);
+        return;
+    }
+    da_append(&thread->jobs, run);
+}
+
+// @return the ticks that were run before the budget ran out
+static size_t run_ticks(SimThread *thread, size_t ticks, double budget) {
+    history_record_start(thread);
+    double end = get_time() + budget;
+    for(size_t i = 0; i < ticks; i++) {
+        sim_clock_tick(thread->context);
+        atomic_fetch_add(&thread->ticks, 1);
+        history_record_tick(thread);
+        if(get_time() >= end) return i + 1;
+    }
+    return ticks;
+}
+
+// runs the ticks owed since the last time, for at most SIM_THREAD_RUN_BUDGET seconds
+// @return when the next tick is due
+static double run_owed_ticks(SimThread *thread) {
+    SimRun *run = &thread->run;
+    if(run->rate == 0) {
+        run_ticks(thread, SIZE_MAX, SIM_THREAD_RUN_BUDGET);
+        return get_time();
+    }
+
+    double now = get_time();
+    run->owed += (now - run->time)*run->rate;
+    run->time = now;
+    if(run->owed > run->rate*SIM_THREAD_RUN_MAX_BACKLOG) run->owed = run->rate*SIM_THREAD_RUN_MAX_BACKLOG;
+
+    // only the ticks that ran are paid, the rest are kept for the next time
+    run->owed -= run_ticks(thread, run->owed, SIM_THREAD_RUN_BUDGET);
+    return run->time + (1 - run->owed)/run->rate;
+}
+
+static void apply_command(SimThread *thread, SimCommand *command) {
+    switch(command->type) {
+        case SIM_COMMAND_ADD_CHIP:
+            sim_add_chip(thread->context, command->chip);
+            break;
+        case SIM_COMMAND_REMOVE_CHIP:
+            sim_remove_chip(thread->context, command->chip);
+            sim_chip_free(command->chip);
+            break;
+        case SIM_COMMAND_CONNECT:
+            if(!sim_pin_add_connection(command->src, command->target)) {
+                printf("[ERROR] Couldn't connect the pins, they should be an output and an input of the same width\n");
+            }
+            break;
+        case SIM_COMMAND_DISCONNECT:
+            sim_pin_remove_connection(command->src, command->target);
+            break;
+        case SIM_COMMAND_TOGGLE:
+            history_record_start(thread);
+            if(!sim_chip_toggle_output_pin(command->chip, command->index)) {
+                printf("[ERROR] The chip has no output %zu to toggle\n", command->index);
+                break;
+            }
+            history_record(thread);
+            break;
+        case SIM_COMMAND_TICK:
+            history_record_start(thread);
+            sim_clock_tick(thread->context);
+            atomic_fetch_add(&thread->ticks, 1);
+            history_record(thread);
+            break;
+        case SIM_COMMAND_RUN:
+            thread->run = (SimRun){
+                .running = true,
+                .rate = command->index,
+                .time = get_time(),
+            };
+            break;
+        case SIM_COMMAND_STOP:
+            thread->run.running = false;
+            // the state where it stopped is kept, even between the intervals
+            if(thread->history.ticks > 0) history_record(thread);
+            break;
+        case SIM_COMMAND_WATCH:
+            while(thread->watched.count <= command->index) {
+                da_append(&thread->watched, NULL);
+            }
+            thread->watched.items[command->index] = command->src;
+            break;
+        case SIM_COMMAND_FAST_FORWARD:
+            fast_forward(thread, command->index, false);
+            break;
+        case SIM_COMMAND_FAST_FORWARD_UNTIL_CHANGE:
+            fast_forward(thread, command->index, true);
+            break;
+        case SIM_COMMAND_RESET:
+            history_record_start(thread);
+            sim_reset(thread->context);
+            history_record(thread);
+            break;
+        case SIM_COMMAND_SCRUB:
+            scrub(thread, command->steps);
+            break;
+        case SIM_COMMAND_JOB:
+            start_job(thread, command);
+            break;
+    }
+}
+
+// takes the queued commands and runs them
+static size_t run_queue(SimThread *thread) {
+    pthread_mutex_lock(&thread->queueMutex);
+    SimCommandArray commands = thread->queue;
+    thread->queue = thread->batch;
+    pthread_mutex_unlock(&thread->queueMutex);
+
+    for(size_t i = 0; i < commands.count; i++) {
+        apply_command(thread, &commands.items[i]);
+    }
+    size_t count = commands.count;
+    commands.count = 0;
+    thread->batch = commands;
+    return count;
+}
+
+static SimPinState get_pin_state(SimPin *pin) {
+    if(pin == NULL) return PIN_LOW;
+    if(sim_pin_is_unknown(pin)) return PIN_X;
+    return sim_pin_is_high(pin) ? PIN_HIGH : PIN_LOW;
+}
+
+static void publish(SimThread *thread) {
+    SimPinStateArray *back = &thread->buffers[thread->back];
+    back->count = 0;
+    for(size_t i = 0; i < thread->watched.count; i++) {
+        da_append(back, get_pin_state(thread->watched.items[i]));
+    }
+    thread->back = atomic_exchange(&thread->middle, thread->back | SIM_THREAD_FRESH) & ~SIM_THREAD_FRESH;
+}
+
+static struct timespec to_timespec(double time) {
+    return (struct timespec){
+        .tv_sec = time,
+        .tv_nsec = (time - (time_t)time)*1e9,
+    };
+}
+
+static void *simulation_thread(void *data) {
+    SimThread *thread = data;
+    // when the next tick of the run mode is due, 0 when it isn't running
+    double wake = 0;
+
+    pthread_mutex_lock(&thread->queueMutex);
+    while(!thread->stop) {
+        if(thread->queue.count == 0) {
+            if(wake == 0) {
+                pthread_cond_wait(&thread->queued, &thread->queueMutex);
+                continue;
+            }
+            if(get_time() < wake) {
+                struct timespec until = to_timespec(wake);
+                pthread_cond_timedwait(&thread->queued, &thread->queueMutex, &until);
+                continue;
+            }
+        }
+        pthread_mutex_unlock(&thread->queueMutex);
+
+        size_t count = run_queue(thread);
+        // the run mode goes on between the commands, without waiting for anyone to read the states
+        wake = thread->run.running ? run_owed_ticks(thread) : 0;
+        publish(thread);
+        atomic_fetch_sub(&thread->pending, count);
+
+        pthread_mutex_lock(&thread->queueMutex);
+    }
+    pthread_mutex_unlock(&thread->queueMutex);
+    return NULL;
+}
+
+SimThread *sim_thread_start(SimContext *context) {
+    SimThread *thread = alloc(sizeof(SimThread));
+    thread->context = context;
+    pthread_mutex_init(&thread->queueMutex, NULL);
+    // the run mode waits for its ticks with the same clock as get_time
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&thread->queued, &attributes);
+    pthread_condattr_destroy(&attributes);
+    atomic_init(&thread->pending, 0);
+    atomic_init(&thread->ticks, 0);
+    thread->back = 0;
+    atomic_init(&thread->middle, 1);
+    thread->front = 2;
+
+    pthread_create(&thread->thread, NULL, simulation_thread, thread);
+    return thread;
+}
+
+void sim_thread_stop(SimThread *thread) {
+    pthread_mutex_lock(&thread->queueMutex);
+    thread->stop = true;
+    pthread_cond_signal(&thread->queued);
+    pthread_mutex_unlock(&thread->queueMutex);
+    pthread_join(thread->thread, NULL);
+
+    join_jobs(&thread->jobs, false);
+    if(thread->jobs.count > 0) printf("[INFO] Waiting for the jobs that are still running\n");
+    join_jobs(&thread->jobs, true);
+    da_free(&thread->jobs);
+
+    pthread_mutex_destroy(&thread->queueMutex);
+    pthread_cond_destroy(&thread->queued);
+    da_free(&thread->queue);
+    da_free(&thread->batch);
+    da_free(&thread->watched);
+    da_free(&thread->freeSlots);
+    history_clear(&thread->history);
+    free(thread->history.items);
+    for(size_t i = 0; i < 3; i++) {
+        da_free(&thread->buffers[i]);
+    }
+    free(thread);
+}
+
+void sim_thread_post(SimThread *thread, SimCommand command) {
+    atomic_fetch_add(&thread->pending, 1);
+    pthread_mutex_lock(&thread->queueMutex);
+    da_append(&thread->queue, command);
+    pthread_cond_signal(&thread->queued);
+    pthread_mutex_unlock(&thread->queueMutex);
+}
+
+size_t sim_thread_watch(SimThread *thread, SimPin *pin) {
+    size_t slot;
+    if(thread->freeSlots.count > 0) {
+        slot = thread->freeSlots.items[--thread->freeSlots.count];
+    } else {
+        slot = thread->nextSlot++;
+    }
+    sim_thread_post(thread, (SimCommand){ .type = SIM_COMMAND_WATCH, .src = pin, .index = slot });
+    return slot;
+}
+
+void sim_thread_unwatch(SimThread *thread, size_t slot) {
+    // the slot can be given to another pin right away, the commands run in order
+    sim_thread_post(thread, (SimCommand){ .type = SIM_COMMAND_WATCH, .src = NULL, .index = slot });
+    da_append(&thread->freeSlots, slot);
+}
+
+SimPinStateArray *sim_thread_read(SimThread *thread) {
+    if(atomic_load(&thread->middle) & SIM_THREAD_FRESH) {
+        thread->front = atomic_exchange(&thread->middle, thread->front) & ~SIM_THREAD_FRESH;
+    }
+    return &thread->buffers[thread->front];
+}
+
+bool sim_thread_busy(SimThread *thread) {
+    return atomic_load(&thread->pending) > 0 || (atomic_load(&thread->middle) & SIM_THREAD_FRESH);
+}
@@ -0,0 +1,219 @@
+#ifndef SIMULATION_THREAD_H
+#define SIMULATION_THREAD_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "simulation.h"
+#include "simulation_snapshot.h"
+
+/*
+ * Runs a context on its own thread, so a long propagation never blocks the
+ * thread that shows it.
+ *
+ * The other thread never changes the context, it posts commands that the
+ * simulation thread runs in order. After every batch of commands the state of
+ * the "watched" pins is copied to a snapshot, and the other thread reads the
+ * last snapshot without locks: there are three buffers, one being written,
+ * one being read and the last one published, and they're swapped atomically.
+ *
+ * The history of snapshots used to go back in time is kept by the simulation
+ * thread too. The commands that change the state record it, except the runs of
+ * many ticks that only record every SIM_THREAD_HISTORY_INTERVAL ticks. It's limited
+ * by the number of snapshots and by the memory they take.
+ *
+ * Long tasks that only read the context (like a sweep) run as jobs: the simulation
+ * thread clones the context when it gets to the command and the job runs on the
+ * clone in another thread, so neither the commands nor the posting thread wait.
+ *
+ * Only one thread should post commands, watch pins and read.
+ */
+
+// snapshots kept to go back in time, the oldest ones are dropped
+#define SIM_THREAD_HISTORY_SIZE 100000
+// memory the snapshots can take before the oldest ones are dropped, the pages that a
+// snapshot shares with an older one are only counted once (see SimSnapshot.bytes)
+#define SIM_THREAD_HISTORY_MAX_BYTES ((size_t)256*1024*1024)
+// ticks between the snapshots recorded by SIM_COMMAND_RUN and SIM_COMMAND_FAST_FORWARD
+#define SIM_THREAD_HISTORY_INTERVAL 100
+// seconds between those snapshots at least, so a fast run takes at most 100 per second
+#define SIM_THREAD_HISTORY_MIN_PERIOD 0.01
+
+// seconds the run mode ticks before looking for new commands and publishing the states
+#define SIM_THREAD_RUN_BUDGET 0.008
+// the ticks that couldn't be run are kept for at most this many seconds, so a slow
+// circuit doesn't accumulate ticks forever
+#define SIM_THREAD_RUN_MAX_BACKLOG 0.25
+
+/*
+ * Runs on its own thread with a clone of the context that it shouldn't free.
+ * "chips" are the clones of the chips of the command, or NULL.
+ */
+typedef void (*SimJob)(SimContext *context, Set *chips, void *data);
+
+// a job started by SIM_COMMAND_JOB, see simulation_thread.c
+typedef struct SimJobRun SimJobRun;
+
+typedef struct {
+    SimJobRun **items;
+    size_t count;
+    size_t capacity;
+} SimJobRunArray;
+
+typedef enum {
+    SIM_COMMAND_ADD_CHIP,
+    // also frees the chip
+    SIM_COMMAND_REMOVE_CHIP,
+    SIM_COMMAND_CONNECT,
+    SIM_COMMAND_DISCONNECT,
+    // toggles the output "index" of an input chip and records a snapshot in the history
+    SIM_COMMAND_TOGGLE,
+    // ticks the clocks and records a snapshot in the history
+    SIM_COMMAND_TICK,
+    // ticks the clocks "index" times per second (0 is as fast as possible) between
+    // the other commands, until SIM_COMMAND_STOP
+    SIM_COMMAND_RUN,
+    SIM_COMMAND_STOP,
+    // copies "src" to the slot "index" of the snapshots, or stops copying it when "src" is NULL
+    SIM_COMMAND_WATCH,
+    // runs the clocks for "index" cycles in a netlist
+    SIM_COMMAND_FAST_FORWARD,
+    // like SIM_COMMAND_FAST_FORWARD but stops early when any output chip changes
+    SIM_COMMAND_FAST_FORWARD_UNTIL_CHANGE,
+    // puts the circuit in its power-on state, the history is kept
+    SIM_COMMAND_RESET,
+    // moves "steps" snapshots through the history, it's cleared when the circuit changed since
+    SIM_COMMAND_SCRUB,
+    // starts "job" with "data" and a clone of the context, takes "chips" (can be NULL),
+    // it isn't started when the same job is still running
+    SIM_COMMAND_JOB,
+} SimCommandType;
+
+typedef struct {
+    SimCommandType type;
+    SimChip *chip;
+    SimPin *src;
+    SimPin *target;
+    size_t index;
+    long steps;
+    SimJob job;
+    Set *chips;
+    void *data;
+} SimCommand;
+
+typedef struct {
+    SimCommand *items;
+    size_t count;
+    size_t capacity;
+} SimCommandArray;
+
+// PIN_HIGH, PIN_LOW or PIN_X (also used for Z) for each slot, a bus is HIGH when any bit is HIGH
+typedef struct {
+    SimPinState *items;
+    size_t count;
+    size_t capacity;
+} SimPinStateArray;
+
+typedef struct {
+    SimPin **items;
+    size_t count;
+    size_t capacity;
+} SimPinPtrArray;
+
+typedef struct {
+    size_t *items;
+    size_t count;
+    size_t capacity;
+} SimSlotArray;
+
+// a ring buffer of SIM_THREAD_HISTORY_SIZE snapshots that starts at "first",
+// "cursor" is the snapshot the context is in counting from the oldest one
+typedef struct {
+    SimSnapshot **items;
+    size_t first;
+    size_t count;
+    size_t cursor;
+    // sum of SimSnapshot.bytes of the snapshots, at most SIM_THREAD_HISTORY_MAX_BYTES
+    size_t bytes;
+    // ticks run since the last snapshot and when it was taken
+    size_t ticks;
+    double time;
+} SimHistory;
+
+// the clocks ticking on their own, see SIM_COMMAND_RUN
+typedef struct {
+    bool running;
+    size_t rate;
+    // ticks that should have run but didn't yet
+    double owed;
+    // time until "owed" is counted
+    double time;
+} SimRun;
+
+typedef struct {
+    SimContext *context;
+    pthread_t thread;
+
+    pthread_mutex_t queueMutex;
+    pthread_cond_t queued;
+    SimCommandArray queue;
+    bool stop;
+    // commands that weren't published yet
+    atomic_size_t pending;
+    // clock ticks run by SIM_COMMAND_TICK and SIM_COMMAND_RUN since the thread started
+    atomic_size_t ticks;
+
+    // only used by the simulation thread
+    SimCommandArray batch;
+    SimPinPtrArray watched;
+    size_t back;
+    SimHistory history;
+    SimRun run;
+    // the jobs started, the ones that ended are joined when the next one starts
+    SimJobRunArray jobs;
+
+    // only used by the thread that posts
+    size_t front;
+    size_t nextSlot;
+    SimSlotArray freeSlots;
+
+    SimPinStateArray buffers[3];
+    // index of the published buffer, with SIM_THREAD_FRESH when it wasn't read yet
+    atomic_size_t middle;
+} SimThread;
+
+/*
+ * Starts running "context" on a new thread, from now on it should only be
+ * used through the commands.
+ */
+SimThread *sim_thread_start(SimContext *context);
+
+/*
+ * Stops the thread and waits for the jobs that are running, the commands that
+ * didn't run yet are lost. The context isn't freed.
+ */
+void sim_thread_stop(SimThread *thread);
+
+void sim_thread_post(SimThread *thread, SimCommand command);
+
+/*
+ * Copies the state of "pin" to the snapshots from now on.
+ *
+ * @return the slot of the pin in the snapshots
+ */
+size_t sim_thread_watch(SimThread *thread, SimPin *pin);
+
+void sim_thread_unwatch(SimThread *thread, size_t slot);
+
+/*
+ * @return the last snapshot published, it's valid until the next call. The slots
+ * that weren't published yet aren't in it.
+ */
+SimPinStateArray *sim_thread_read(SimThread *thread);
+
+/*
+ * @return true when there are commands that weren't published or a snapshot that wasn't read
+ */
+bool sim_thread_busy(SimThread *thread);
+
+#endif // SIMULATION_THREAD_H
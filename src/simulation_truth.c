@@ -0,0 +1,306 @@
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "simulation_truth.h"
+#include "simulation_netlist.h"
+#include "simulation_stimulus.h"
+
+typedef struct {
+    SimContext *context;
+    size_t inputCount;
+    size_t outputCount;
+    size_t rowCount;
+    // rows in a word, less than 64 when there are less than 6 inputs
+    size_t lanes;
+    size_t wordCount;
+
+    size_t blockCount;
+    // the workers take the blocks in order until there are none left
+    atomic_size_t nextBlock;
+
+    // the blocks are written in order, a worker waits until the previous one is written
+    FILE *file;
+    size_t nextWrite;
+    pthread_mutex_t mutex;
+    pthread_cond_t written;
+} TruthTable;
+
+typedef struct {
+    SimPin **items;
+    size_t count;
+    size_t capacity;
+} PinArray;
+
+typedef struct {
+    TruthTable *table;
+    SimContext *clone;
+    pthread_t thread;
+} TruthTableWorker;
+
+// lanes where bit "i" of the lane index is set, the 6 lowest input bits of a word
+static const uint64_t lanePatterns[6] = {
+    0xAAAAAAAAAAAAAAAAllu,
+    0xCCCCCCCCCCCCCCCCllu,
+    0xF0F0F0F0F0F0F0F0llu,
+    0xFF00FF00FF00FF00llu,
+    0xFFFF0000FFFF0000llu,
+    0xFFFFFFFF00000000llu,
+};
+
+static SimPin *add_selection_input(SimContext *context, size_t width) {
+    if(width == 1) {
+        SimChip *input = sim_chip_new(SIM_CHIP_INPUT);
+        sim_add_chip(context, input);
+        return &input->outputs.items[0];
+    }
+
+    SimChip *merger = sim_chip_new_bus(SIM_CHIP_MERGER, width);
+    for(size_t bit = 0; bit < width; bit++) {
+        SimChip *input = sim_chip_new(SIM_CHIP_INPUT);
+        sim_add_chip(context, input);
+        sim_pin_add_connection(&input->outputs.items[0], &merger->inputs.items[bit]);
+    }
+    sim_add_chip(context, merger);
+    return &merger->outputs.items[0];
+}
+
+static void add_selection_output(SimContext *context, SimPin *pin) {
+    if(pin->width == 1) {
+        SimChip *output = sim_chip_new(SIM_CHIP_OUTPUT);
+        sim_add_chip(context, output);
+        sim_pin_add_connection(pin, &output->inputs.items[0]);
+        return;
+    }
+
+    SimChip *splitter = sim_chip_new_bus(SIM_CHIP_SPLITTER, pin->width);
+    sim_add_chip(context, splitter);
+    sim_pin_add_connection(pin, &splitter->inputs.items[0]);
+    for(size_t bit = 0; bit < pin->width; bit++) {
+        SimChip *output = sim_chip_new(SIM_CHIP_OUTPUT);
+        sim_add_chip(context, output);
+        sim_pin_add_connection(&splitter->outputs.items[bit], &output->inputs.items[0]);
+    }
+}
+
+static bool is_selected(Map *selected, SimChip *chip) {
+    size_t unused;
+    return map_get(selected, chip, &unused);
+}
+
+// copies the selection to a new context where the pins at its edge are inputs and outputs
+static SimContext *extract_selection(SimContext *context, Set *chips) {
+    SimContext *clone = sim_context_clone_chips(context, chips);
+
+    // the copies are in the same order as the selected chips of the context
+    Map *selected = map_new();
+    for(SetItem *item = chips->head; item != NULL; item = item->next) {
+        map_set(selected, item->data, 0);
+    }
+    SimChip **copies = alloc((clone->chips->count + 1)*sizeof(SimChip *));
+    size_t copyCount = 0;
+    for(SetItem *item = clone->chips->head; item != NULL; item = item->next) {
+        copies[copyCount++] = item->data;
+    }
+
+    // the output pin that drives every input pin, as an index + 1 of "drivers"
+    Map *drivenBy = map_new();
+    PinArray drivers = {0};
+    for(SetItem *item = context->chips->head; item != NULL; item = item->next) {
+        SimChip *chip = item->data;
+        for(size_t i = 0; i < chip->outputs.count; i++) {
+            SimPin *pin = &chip->outputs.items[i];
+            if(pin->connectedPins->count == 0) continue;
+            da_append(&drivers, pin);
+            for(SetItem *target = pin->connectedPins->head; target != NULL; target = target->next) {
+                map_set(drivenBy, target->data, drivers.count);
+            }
+        }
+    }
+
+    // the inputs of the table are added in the order they're found, one for each outside pin
+    SimPin **driverInputs = alloc((drivers.count + 1)*sizeof(SimPin *));
+    size_t copyIndex = 0;
+    for(SetItem *item = context->chips->head; item != NULL; item = item->next) {
+        SimChip *chip = item->data;
+        if(!is_selected(selected, chip)) continue;
+        SimChip *chipCopy = copies[copyIndex++];
+
+        for(size_t i = 0; i < chip->inputs.count; i++) {
+            SimPin *pin = &chip->inputs.items[i];
+            size_t driver;
+            bool driven = map_get(drivenBy, pin, &driver);
+            if(driven && is_selected(selected, drivers.items[driver - 1]->parentChip)) continue;
+
+            SimPin *input;
+            if(!driven) {
+                input = add_selection_input(clone, pin->width);
+            } else {
+                if(driverInputs[driver - 1] == NULL) driverInputs[driver - 1] = add_selection_input(clone, pin->width);
+                input = driverInputs[driver - 1];
+            }
+            sim_pin_add_connection(input, &chipCopy->inputs.items[i]);
+        }
+
+        for(size_t i = 0; i < chip->outputs.count; i++) {
+            SimPin *pin = &chip->outputs.items[i];
+            bool outside = pin->connectedPins->count == 0;
+            for(SetItem *target = pin->connectedPins->head; target != NULL; target = target->next) {
+                SimPin *targetPin = target->data;
+                if(!is_selected(selected, targetPin->parentChip)) outside = true;
+            }
+            if(outside) add_selection_output(clone, &chipCopy->outputs.items[i]);
+        }
+    }
+
+    free(driverInputs);
+    free(copies);
+    da_free(&drivers);
+    map_free(drivenBy);
+    map_free(selected);
+    return clone;
+}
+
+static void set_word_inputs(TruthTable *table, SimNetlist *netlist, size_t word) {
+    for(size_t i = 0; i < table->inputCount; i++) {
+        // the first input is the most significant bit of the row
+        size_t bit = table->inputCount - 1 - i;
+        uint64_t value;
+        if(bit < 6) {
+            value = lanePatterns[bit];
+        } else {
+            value = (word >> (bit - 6)) & 1 ? ~0llu : 0;
+        }
+        sim_netlist_set_input(netlist, i, value);
+    }
+}
+
+static size_t write_word(TruthTable *table, SimNetlist *netlist, size_t word, char *buffer) {
+    char *cursor = buffer;
+    for(size_t lane = 0; lane < table->lanes; lane++) {
+        size_t row = word*64 + lane;
+        for(size_t i = 0; i < table->inputCount; i++) {
+            *cursor++ = (row >> (table->inputCount - 1 - i)) & 1 ? '1' : '0';
+        }
+        *cursor++ = ' ';
+        for(size_t i = 0; i < table->outputCount; i++) {
+            *cursor++ = (sim_netlist_get_output(netlist, i) >> lane) & 1 ? '1' : '0';
+        }
+        *cursor++ = '\n';
+    }
+    return cursor - buffer;
+}
+
+static void write_block(TruthTable *table, size_t block, char *buffer, size_t size) {
+    pthread_mutex_lock(&table->mutex);
+    while(table->nextWrite != block) {
+        pthread_cond_wait(&table->written, &table->mutex);
+    }
+    fwrite(buffer, 1, size, table->file);
+    table->nextWrite++;
+    pthread_cond_broadcast(&table->written);
+    pthread_mutex_unlock(&table->mutex);
+}
+
+static void *truth_table_worker(void *data) {
+    TruthTableWorker *worker = data;
+    TruthTable *table = worker->table;
+
+    SimNetlist *netlist = sim_netlist_compile(worker->clone->chips, (SimNetlistOptions){
+        .optimize = true,
+        .backend = SIM_BACKEND_VM,
+    });
+    assert(netlist->inputs.count == table->inputCount && netlist->outputs.count == table->outputCount);
+    netlist->lanes = table->lanes;
+
+    // with a state the rows could depend on the previous ones, so every word starts from the beginning
+    bool stateful = netlist->hasFeedback || netlist->sequential.count > 0;
+    SimNetlistState initial = sim_netlist_save_state(netlist);
+
+    size_t rowSize = table->inputCount + table->outputCount + 2;
+    char *buffer = alloc(SIM_TRUTH_TABLE_BLOCK_WORDS*table->lanes*rowSize);
+
+    for(;;) {
+        size_t block = atomic_fetch_add(&table->nextBlock, 1);
+        if(block >= table->blockCount) break;
+
+        size_t first = block*SIM_TRUTH_TABLE_BLOCK_WORDS;
+        size_t last = first + SIM_TRUTH_TABLE_BLOCK_WORDS;
+        if(last > table->wordCount) last = table->wordCount;
+
+        size_t written = 0;
+        for(size_t word = first; word < last; word++) {
+            if(stateful) {
+                sim_netlist_load_state(netlist, &initial);
+            }
+            set_word_inputs(table, netlist, word);
+            sim_netlist_eval(netlist);
+            written += write_word(table, netlist, word, &buffer[written]);
+        }
+        write_block(table, block, buffer, written);
+    }
+
+    free(buffer);
+    sim_netlist_state_free(&initial);
+    sim_netlist_free(netlist);
+    return NULL;
+}
+
+bool sim_truth_table_run(SimContext *context, Set *chips, const char *path, SimTruthTableOptions options) {
+    SimContext *selection = chips != NULL ? extract_selection(context, chips) : NULL;
+    TruthTable table = {
+        .context = selection != NULL ? selection : context,
+    };
+    table.inputCount = sim_stimulus_count_chips(table.context, SIM_CHIP_INPUT);
+    table.outputCount = sim_stimulus_count_chips(table.context, SIM_CHIP_OUTPUT);
+
+    bool ok = false;
+    if(table.inputCount > SIM_TRUTH_TABLE_MAX_INPUTS) {
+        printf("[ERROR] The truth table has %zu inputs, the max is %d\n", table.inputCount, SIM_TRUTH_TABLE_MAX_INPUTS);
+        goto cleanup;
+    }
+
+    table.file = fopen(path, "wb");
+    if(table.file == NULL) {
+        printf("[ERROR] Couldn't open %s\n", path);
+        goto cleanup;
+    }
+    fprintf(table.file, "# %zu inputs, %zu outputs\n", table.inputCount, table.outputCount);
+
+    table.rowCount = (size_t)1 << table.inputCount;
+    table.lanes = table.rowCount < 64 ? table.rowCount : 64;
+    table.wordCount = table.rowCount / table.lanes;
+    table.blockCount = (table.wordCount + SIM_TRUTH_TABLE_BLOCK_WORDS - 1) / SIM_TRUTH_TABLE_BLOCK_WORDS;
+    atomic_init(&table.nextBlock, 0);
+    pthread_mutex_init(&table.mutex, NULL);
+    pthread_cond_init(&table.written, NULL);
+
+    size_t threads = options.threads;
+    if(threads == 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if(threads > table.blockCount) threads = table.blockCount;
+
+    // the clones are made before any thread starts, so the context is only read here
+    TruthTableWorker *workers = alloc(threads*sizeof(TruthTableWorker));
+    for(size_t i = 0; i < threads; i++) {
+        workers[i].table = &table;
+        workers[i].clone = sim_context_clone(table.context);
+        pthread_create(&workers[i].thread, NULL, truth_table_worker, &workers[i]);
+    }
+    for(size_t i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        sim_context_free_chips(workers[i].clone);
+    }
+    free(workers);
+
+    pthread_mutex_destroy(&table.mutex);
+    pthread_cond_destroy(&table.written);
+
+    ok = !ferror(table.file);
+    if(!ok) printf("[ERROR] Couldn't write %s\n", path);
+    fclose(table.file);
+
+cleanup:
+    if(selection != NULL) sim_context_free_chips(selection);
+    return ok;
+}
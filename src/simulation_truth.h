@@ -0,0 +1,46 @@
+#ifndef SIMULATION_TRUTH_H
+#define SIMULATION_TRUTH_H
+
+#include "simulation.h"
+
+/*
+ * Writes the truth table of a circuit, a row for each of the 2^n combinations
+ * of its n inputs in counting order (the first input is the most significant
+ * bit). A row has the value of every input, a space and the value of every
+ * output:
+ *
+ *   # 2 inputs, 1 outputs
+ *   00 1
+ *   01 1
+ *   10 1
+ *   11 0
+ *
+ * With a selection of chips the inputs are the input pins that aren't driven
+ * by another selected chip, and the outputs are the output pins that aren't
+ * connected or are read by a chip outside the selection. Pins connected to the
+ * same outside pin share an input, and a bus is a column for each bit. Without
+ * a selection they're the SIM_CHIP_INPUT and SIM_CHIP_OUTPUT chips.
+ *
+ * The circuit is compiled to an optimized two-state netlist, so the
+ * combinations are evaluated 64 at a time, and the blocks of rows are split
+ * between threads and written in order as they're done. Every combination
+ * starts from the current state of the chips and the clocks don't tick.
+ */
+
+#define SIM_TRUTH_TABLE_MAX_INPUTS 30
+
+// words of 64 rows evaluated by a thread before writing them
+#define SIM_TRUTH_TABLE_BLOCK_WORDS 256
+
+typedef struct {
+    // worker threads, 0 uses one for each processor
+    size_t threads;
+} SimTruthTableOptions;
+
+/*
+ * @param chips the selection, NULL for the whole context
+ * @return false when there are too many inputs or the file can't be written
+ */
+bool sim_truth_table_run(SimContext *context, Set *chips, const char *path, SimTruthTableOptions options);
+
+#endif // SIMULATION_TRUTH_H
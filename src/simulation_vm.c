@@ -0,0 +1,225 @@
+#include "simulation_vm.h"
+
+typedef struct {
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} Bytecode;
+
+// indexed by [fourState][feedback]
+static const SimVMOpcode nandOpcodes[2][2] = {
+    { SIM_VM_NAND, SIM_VM_NAND_FEEDBACK },
+    { SIM_VM_NAND_4, SIM_VM_NAND_FEEDBACK_4 },
+};
+static const SimVMOpcode lutOpcodes[2] = { SIM_VM_LUT, SIM_VM_LUT_FEEDBACK };
+// indexed by [gate type - SIM_NET_GATE_AND][fourState][feedback]
+static const SimVMOpcode wideOpcodes[5][2][2] = {
+    { { SIM_VM_AND, SIM_VM_AND_FEEDBACK }, { SIM_VM_AND_4, SIM_VM_AND_FEEDBACK_4 } },
+    { { SIM_VM_OR, SIM_VM_OR_FEEDBACK }, { SIM_VM_OR_4, SIM_VM_OR_FEEDBACK_4 } },
+    { { SIM_VM_XOR, SIM_VM_XOR_FEEDBACK }, { SIM_VM_XOR_4, SIM_VM_XOR_FEEDBACK_4 } },
+    { { SIM_VM_NOR, SIM_VM_NOR_FEEDBACK }, { SIM_VM_NOR_4, SIM_VM_NOR_FEEDBACK_4 } },
+    { { SIM_VM_XNOR, SIM_VM_XNOR_FEEDBACK }, { SIM_VM_XNOR_4, SIM_VM_XNOR_FEEDBACK_4 } },
+};
+
+SimVMProgram *sim_vm_compile(SimNetlist *netlist) {
+    SimVMProgram *program = alloc(sizeof(SimVMProgram));
+    Bytecode code = {0};
+
+    for(size_t i = 0; i < netlist->gates.count; i++) {
+        SimNetGate *gate = &netlist->gates.items[i];
+
+        switch(gate->type) {
+            case SIM_NET_GATE_NAND:
+                da_append(&code, nandOpcodes[netlist->fourState][gate->feedback]);
+                da_append(&code, gate->output);
+                da_append(&code, gate->inputs[0]);
+                da_append(&code, gate->inputs[1]);
+                break;
+            case SIM_NET_GATE_LUT:
+                assert(!netlist->fourState && "The LUT gates don't support four-state logic");
+                da_append(&code, lutOpcodes[gate->feedback]);
+                da_append(&code, gate->output);
+                da_append(&code, program->lutCount);
+                da_append(&code, gate->inputCount);
+                for(size_t j = 0; j < gate->inputCount; j++) {
+                    da_append(&code, gate->inputs[j]);
+                }
+
+                program->luts = realloc(program->luts, (program->lutCount + 1)*sizeof(SimNetGate *));
+                assert(program->luts != NULL && "No enough ram");
+                // the netlist outlives the program
+                program->luts[program->lutCount++] = gate;
+                break;
+            default:
+                da_append(&code, wideOpcodes[gate->type - SIM_NET_GATE_AND][netlist->fourState][gate->feedback]);
+                da_append(&code, gate->output);
+                da_append(&code, gate->inputCount);
+                for(size_t j = 0; j < gate->inputCount; j++) {
+                    da_append(&code, gate->inputs[j]);
+                }
+                break;
+        }
+    }
+    da_append(&code, SIM_VM_HALT);
+
+    program->code = code.items;
+    program->size = code.count;
+    return program;
+}
+
+void sim_vm_free(SimVMProgram *program) {
+    free(program->code);
+    free(program->luts);
+    free(program);
+}
+
+// with a single lane the table is looked up, with more the program runs in every lane at once
+static inline uint64_t vm_lut(SimNetGate *lut, uint32_t *inputs, uint64_t *values, size_t lanes) {
+    if(lanes > 1) return sim_net_lut_run(lut->program, lut->programCount, inputs, lut->inputCount, values);
+
+    size_t index = 0;
+    for(size_t i = 0; i < lut->inputCount; i++) {
+        index |= (values[inputs[i]] & 1) << i;
+    }
+    return (lut->table[index / 64] >> (index % 64)) & 1;
+}
+
+#define VM_LOGIC(net) ((SimLogic){ .high = values[net], .low = lows[net] })
+
+// reduces the inputs of a wide gate with "op", "inverted" is a constant so the check is free
+#define VM_REDUCE(op, inverted) \
+    value = values[pc[3]]; \
+    for(uint32_t i = 1; i < pc[2]; i++) value op##= values[pc[3 + i]]; \
+    if(inverted) value = ~value
+
+#define VM_REDUCE_4(function, inverted) \
+    logic = VM_LOGIC(pc[3]); \
+    for(uint32_t i = 1; i < pc[2]; i++) logic = function(logic, VM_LOGIC(pc[3 + i])); \
+    if(inverted) logic = sim_logic_not(logic)
+
+// the four opcodes of a type of wide gate
+#define VM_WIDE_CASES(name, op, function, inverted) \
+    VM_CASE(SIM_VM_##name): \
+        VM_REDUCE(op, inverted); \
+        values[pc[1]] = value; \
+        pc += 3 + pc[2]; \
+        VM_DISPATCH(); \
+    VM_CASE(SIM_VM_##name##_FEEDBACK): \
+        VM_REDUCE(op, inverted); \
+        changed |= values[pc[1]] ^ value; \
+        values[pc[1]] = value; \
+        pc += 3 + pc[2]; \
+        VM_DISPATCH(); \
+    VM_CASE(SIM_VM_##name##_4): \
+        VM_REDUCE_4(function, inverted); \
+        values[pc[1]] = logic.high; \
+        lows[pc[1]] = logic.low; \
+        pc += 3 + pc[2]; \
+        VM_DISPATCH(); \
+    VM_CASE(SIM_VM_##name##_FEEDBACK_4): \
+        VM_REDUCE_4(function, inverted); \
+        changed |= (values[pc[1]] ^ logic.high) | (lows[pc[1]] ^ logic.low); \
+        values[pc[1]] = logic.high; \
+        lows[pc[1]] = logic.low; \
+        pc += 3 + pc[2]; \
+        VM_DISPATCH();
+
+// with GCC and Clang every instruction jumps straight to the next one (computed goto),
+// otherwise it falls back to a switch inside a loop
+#if defined(__GNUC__)
+#define VM_THREADED
+#endif
+
+#ifdef VM_THREADED
+#define VM_CASE(opcode) label_##opcode
+#define VM_DISPATCH() goto *labels[*pc]
+#define VM_WIDE_LABELS(name) \
+    [SIM_VM_##name] = &&label_SIM_VM_##name, \
+    [SIM_VM_##name##_FEEDBACK] = &&label_SIM_VM_##name##_FEEDBACK, \
+    [SIM_VM_##name##_4] = &&label_SIM_VM_##name##_4, \
+    [SIM_VM_##name##_FEEDBACK_4] = &&label_SIM_VM_##name##_FEEDBACK_4,
+#else
+#define VM_CASE(opcode) case opcode
+#define VM_DISPATCH() continue
+#endif
+
+uint64_t sim_vm_run(SimVMProgram *program, uint64_t *restrict values, uint64_t *restrict lows, size_t lanes) {
+    uint32_t *pc = program->code;
+    uint64_t changed = 0;
+    uint64_t value;
+    SimLogic logic;
+
+#ifdef VM_THREADED
+    static void *labels[SIM_VM_OPCODE_COUNT] = {
+        [SIM_VM_HALT] = &&label_SIM_VM_HALT,
+        [SIM_VM_NAND] = &&label_SIM_VM_NAND,
+        [SIM_VM_NAND_FEEDBACK] = &&label_SIM_VM_NAND_FEEDBACK,
+        [SIM_VM_LUT] = &&label_SIM_VM_LUT,
+        [SIM_VM_LUT_FEEDBACK] = &&label_SIM_VM_LUT_FEEDBACK,
+        [SIM_VM_NAND_4] = &&label_SIM_VM_NAND_4,
+        [SIM_VM_NAND_FEEDBACK_4] = &&label_SIM_VM_NAND_FEEDBACK_4,
+        VM_WIDE_LABELS(AND)
+        VM_WIDE_LABELS(OR)
+        VM_WIDE_LABELS(XOR)
+        VM_WIDE_LABELS(NOR)
+        VM_WIDE_LABELS(XNOR)
+    };
+    VM_DISPATCH();
+#else
+    for(;;) switch(*pc) {
+#endif
+
+    VM_CASE(SIM_VM_NAND):
+        values[pc[1]] = ~(values[pc[2]] & values[pc[3]]);
+        pc += 4;
+        VM_DISPATCH();
+
+    VM_CASE(SIM_VM_NAND_FEEDBACK):
+        value = ~(values[pc[2]] & values[pc[3]]);
+        changed |= values[pc[1]] ^ value;
+        values[pc[1]] = value;
+        pc += 4;
+        VM_DISPATCH();
+
+    VM_CASE(SIM_VM_LUT):
+        values[pc[1]] = vm_lut(program->luts[pc[2]], &pc[4], values, lanes);
+        pc += 4 + pc[3];
+        VM_DISPATCH();
+
+    VM_CASE(SIM_VM_LUT_FEEDBACK):
+        value = vm_lut(program->luts[pc[2]], &pc[4], values, lanes);
+        changed |= values[pc[1]] ^ value;
+        values[pc[1]] = value;
+        pc += 4 + pc[3];
+        VM_DISPATCH();
+
+    VM_CASE(SIM_VM_NAND_4):
+        logic = sim_logic_nand(VM_LOGIC(pc[2]), VM_LOGIC(pc[3]));
+        values[pc[1]] = logic.high;
+        lows[pc[1]] = logic.low;
+        pc += 4;
+        VM_DISPATCH();
+
+    VM_CASE(SIM_VM_NAND_FEEDBACK_4):
+        logic = sim_logic_nand(VM_LOGIC(pc[2]), VM_LOGIC(pc[3]));
+        changed |= (values[pc[1]] ^ logic.high) | (lows[pc[1]] ^ logic.low);
+        values[pc[1]] = logic.high;
+        lows[pc[1]] = logic.low;
+        pc += 4;
+        VM_DISPATCH();
+
+    VM_WIDE_CASES(AND, &, sim_logic_and, false)
+    VM_WIDE_CASES(OR, |, sim_logic_or, false)
+    VM_WIDE_CASES(XOR, ^, sim_logic_xor, false)
+    VM_WIDE_CASES(NOR, |, sim_logic_or, true)
+    VM_WIDE_CASES(XNOR, ^, sim_logic_xor, true)
+
+    VM_CASE(SIM_VM_HALT):
+        return changed;
+
+#ifndef VM_THREADED
+    default:
+        panic("Unknown opcode");
+    }
+#endif
+}
@@ -0,0 +1,75 @@
+#ifndef SIMULATION_VM_H
+#define SIMULATION_VM_H
+
+#include "simulation_netlist.h"
+
+/*
+ * The netlist compiled to a dense bytecode. Every instruction is an opcode
+ * followed by the index of the nets it uses, all stored in the same array:
+ *
+ *   NAND: opcode, output, input A, input B
+ *   LUT:  opcode, output, LUT index, input count, inputs...
+ *   WIDE: opcode, output, input count, inputs...
+ *
+ * Every type of wide gate has its own opcodes (AND, OR, XOR, NOR, XNOR), so
+ * the reduction doesn't check the type of the gate.
+ *
+ * The gates of a feedback loop use a different opcode that tracks if
+ * the output changed. With four-state logic the *_4 opcodes are used,
+ * which update both bit-planes (there are no LUT gates then).
+ */
+typedef enum {
+    SIM_VM_HALT,
+    SIM_VM_NAND,
+    SIM_VM_NAND_FEEDBACK,
+    SIM_VM_LUT,
+    SIM_VM_LUT_FEEDBACK,
+    SIM_VM_NAND_4,
+    SIM_VM_NAND_FEEDBACK_4,
+    SIM_VM_AND,
+    SIM_VM_AND_FEEDBACK,
+    SIM_VM_AND_4,
+    SIM_VM_AND_FEEDBACK_4,
+    SIM_VM_OR,
+    SIM_VM_OR_FEEDBACK,
+    SIM_VM_OR_4,
+    SIM_VM_OR_FEEDBACK_4,
+    SIM_VM_XOR,
+    SIM_VM_XOR_FEEDBACK,
+    SIM_VM_XOR_4,
+    SIM_VM_XOR_FEEDBACK_4,
+    SIM_VM_NOR,
+    SIM_VM_NOR_FEEDBACK,
+    SIM_VM_NOR_4,
+    SIM_VM_NOR_FEEDBACK_4,
+    SIM_VM_XNOR,
+    SIM_VM_XNOR_FEEDBACK,
+    SIM_VM_XNOR_4,
+    SIM_VM_XNOR_FEEDBACK_4,
+    SIM_VM_OPCODE_COUNT,
+} SimVMOpcode;
+
+struct SimVMProgram {
+    uint32_t *code;
+    size_t size;
+    // the LUT gates, for their truth tables and programs
+    SimNetGate **luts;
+    size_t lutCount;
+};
+
+/*
+ * Translates the levelized netlist to bytecode, it's instant compared to
+ * the native backend.
+ */
+SimVMProgram *sim_vm_compile(SimNetlist *netlist);
+
+void sim_vm_free(SimVMProgram *program);
+
+/*
+ * Runs the whole program once. "values" and "lows" can't overlap.
+ *
+ * @return a non zero value if any net of a feedback loop changed
+ */
+uint64_t sim_vm_run(SimVMProgram *program, uint64_t *restrict values, uint64_t *restrict lows, size_t lanes);
+
+#endif // SIMULATION_VM_H
@@ -19,7 +19,7 @@ static SetItem *item_new(void *data) {
     return item;
 }
 
-void set_add(Set *set, void *data) {
+SetItem *set_add(Set *set, void *data) {
     SetItem *item = item_new(data);
 
     if(set->count == 0) {
@@ -27,50 +27,38 @@ void set_add(Set *set, void *data) {
     } else {
         // we set the "next" of the last item to this new item
         set->tail->next = item;
+        item->prev = set->tail;
         // then we set the last item to this new item
         set->tail = item;
     }
 
     set->count++;
+    return item;
 }
 
 bool set_delete(Set *set, void *data) {
-    SetItem *item = set->head;
-    SetItem *prevItem = NULL;
-
-    size_t pos = 0;
-
-    while(item != NULL) {
+    for(SetItem *item = set->head; item != NULL; item = item->next) {
         // here we compare pointers to see if it's the item we're looking for
         if(item->data == data) {
-            if(set->count == 1) {
-                // if the set only has one element, we can only empty the list
-                set->tail = set->head = NULL;
-            } else if(pos == 0) {
-                // if the position is 0 but there's more than 1 item
-                set->head = item->next;
-            } else if(pos == set->count - 1) {
-                // if the position is the last item of the list and there's more than 1 item
-                // remove the link between the previous item and this last one
-                prevItem->next = NULL;
-                // set the tail to the previous item
-                set->tail = prevItem;
-            } else {
-                // if we're in the middle we only connect the previous to the next
-                prevItem->next = item->next;
-            }
-            free(item);
-            set->count--;
+            set_delete_item(set, item);
             return true;
         }
-        prevItem = item;
-        item = item->next;
-        pos++;
     }
 
     return false;
 }
 
+void set_delete_item(Set *set, SetItem *item) {
+    // the items around it are connected to each other, or the ends of the set are moved
+    if(item->prev != NULL) item->prev->next = item->next;
+    else set->head = item->next;
+    if(item->next != NULL) item->next->prev = item->prev;
+    else set->tail = item->prev;
+
+    free(item);
+    set->count--;
+}
+
 void set_clear_and_destroy(Set *set) {
     SetItem *item = set->head;
     while(item != NULL) {
@@ -81,3 +69,73 @@ void set_clear_and_destroy(Set *set) {
 
     free(set);
 }
+
+#define MAP_INIT_CAP 64
+
+Map *map_new() {
+    Map *map = alloc(sizeof(Map));
+    map->capacity = MAP_INIT_CAP;
+    map->items = alloc(map->capacity*sizeof(MapItem));
+    return map;
+}
+
+static size_t map_hash(Map *map, void *key) {
+    // the lower bits of a pointer are almost always zero because of the alignment
+    size_t hash = ((size_t)key >> 4) * 11400714819323198485llu;
+    return hash & (map->capacity - 1);
+}
+
+static void map_grow(Map *map) {
+    MapItem *oldItems = map->items;
+    size_t oldCapacity = map->capacity;
+
+    map->capacity *= 2;
+    map->items = alloc(map->capacity*sizeof(MapItem));
+    map->count = 0;
+
+    for(size_t i = 0; i < oldCapacity; i++) {
+        if(oldItems[i].key != NULL) {
+            map_set(map, oldItems[i].key, oldItems[i].value);
+        }
+    }
+
+    free(oldItems);
+}
+
+void map_set(Map *map, void *key, size_t value) {
+    assert(key != NULL && "NULL can't be used as a key");
+
+    // we keep the map at most half full, so the probing stays short
+    if((map->count + 1)*2 > map->capacity) {
+        map_grow(map);
+    }
+
+    size_t i = map_hash(map, key);
+    while(map->items[i].key != NULL && map->items[i].key != key) {
+        i = (i + 1) & (map->capacity - 1);
+    }
+
+    if(map->items[i].key == NULL) {
+        map->items[i].key = key;
+        map->count++;
+    }
+    map->items[i].value = value;
+}
+
+bool map_get(Map *map, void *key, size_t *value) {
+    size_t i = map_hash(map, key);
+    while(map->items[i].key != NULL) {
+        if(map->items[i].key == key) {
+            *value = map->items[i].value;
+            return true;
+        }
+        i = (i + 1) & (map->capacity - 1);
+    }
+
+    return false;
+}
+
+void map_free(Map *map) {
+    free(map->items);
+    free(map);
+}
@@ -29,6 +29,7 @@ typedef struct SetItem SetItem;
 struct SetItem {
     void *data;
     SetItem *next;
+    SetItem *prev;
 };
 
 
@@ -42,10 +43,34 @@ typedef struct {
 } Set;
 
 Set *set_new();
-void set_add(Set *set, void *data);
+// returns the item added, it can be kept to delete it later with set_delete_item
+SetItem *set_add(Set *set, void *data);
 bool set_delete(Set *set, void *data);
+// removes "item" from the set without searching it, the order of the rest doesn't change
+void set_delete_item(Set *set, SetItem *item);
 void set_clear_and_destroy(Set *set);
 
+// open addressing hash map that goes from a pointer to an index
+// like the set, it works comparing pointers
+typedef struct {
+    void *key;
+    size_t value;
+} MapItem;
+
+typedef struct {
+    MapItem *items;
+    size_t count;
+    size_t capacity;
+} Map;
+
+Map *map_new();
+void map_set(Map *map, void *key, size_t value);
+/*
+ * @return false when the key is not in the map
+ */
+bool map_get(Map *map, void *key, size_t *value);
+void map_free(Map *map);
+
 void *alloc(size_t bytes);
 
 #endif // UTILS_H